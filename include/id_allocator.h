@@ -0,0 +1,39 @@
+// id_allocator.h
+// Unique ids for objects that may be created on any thread.
+//
+// A plain static counter is a data race once two threads construct objects,
+// and making it atomic turns it into one cache line that every construction
+// on every core fights over. Instead each thread reserves a block of ids from
+// the shared atomic counter and hands them out without synchronization, so
+// the shared line is touched once per Block ids.
+//
+// Ids are unique across threads (and distinct Tags have separate id spaces).
+// They are not globally ordered; on a single thread they count 1, 2, 3, ...
+// The unused rest of a block is lost when its thread exits.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template<typename Tag, std::uint64_t Block = 1024>
+class Id_allocator {
+public:
+    static std::uint64_t next() {
+        Local& l = local;
+        if (l.next == l.end) {
+            l.next = next_block.fetch_add(Block, std::memory_order_relaxed);
+            l.end = l.next + Block;
+        }
+        return l.next++;
+    }
+
+private:
+    struct Local {
+        std::uint64_t next = 0;
+        std::uint64_t end = 0;
+    };
+
+    static inline std::atomic<std::uint64_t> next_block{1};
+    static inline thread_local Local local;
+};
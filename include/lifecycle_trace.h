@@ -0,0 +1,377 @@
+// lifecycle_trace.h
+// Counts how often objects of a type are constructed, copied, moved, assigned
+// and destroyed, and how often they allocate, so accidental deep copies on hot
+// paths show up in numbers instead of in iostream logs:
+//
+//   class Widget : private Traced<Widget> { ... };
+//
+// A class with its own copy/move operations must pass them on to Traced
+// (Traced<Widget>(other) in the initializer list, Traced<Widget>::operator=(other)
+// in assignments), and can report its allocations with traced_allocation()
+// and traced_deallocation().
+//
+// Each thread counts in its own block, so counting never contends; the blocks
+// are summed on demand by lifecycle_totals() and lifecycle_report(). Between
+// lifecycle_trace_start() and lifecycle_trace_stop() every event is also
+// written, with a timestamp, to a binary trace file that the
+// ch06_lifecycle_report tool summarizes.
+//
+// Recording never throws: a type past the first lifecycle_max_types, or a
+// thread whose counters cannot be allocated, is not counted, and trace records
+// that do not fit are dropped. Objects destroyed after their thread's counters
+// are gone (statics outliving main's thread_locals) are not counted either.
+//
+// Off by default, since every event costs a thread_local lookup and an atomic
+// store: define LIFECYCLE_TRACING=1 to compile it in. Without it the Traced
+// mixin is empty and reports list no types.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define LIFECYCLE_HAVE_CXXABI 1
+#endif
+
+#ifndef LIFECYCLE_TRACING
+#define LIFECYCLE_TRACING 0
+#endif
+
+enum class Lifecycle_event : std::uint8_t {
+    construct, copy_construct, move_construct, copy_assign, move_assign, destroy, allocate, deallocate
+};
+
+constexpr int lifecycle_events = 8;
+constexpr const char* lifecycle_event_names[lifecycle_events] = {
+    "construct", "copy", "move", "copy=", "move=", "destroy", "alloc", "free"
+};
+constexpr int lifecycle_max_types = 64;
+constexpr std::size_t lifecycle_trace_batch = 4096;   // Records buffered per thread between writes
+
+using Lifecycle_counts = std::array<std::uint64_t, lifecycle_events>;
+
+struct Lifecycle_totals {
+    std::string type;
+    Lifecycle_counts counts;
+};
+
+// Trace file layout (native byte order):
+//   "LCTRACE1"
+//   Lifecycle_record...
+//   for each type: std::uint32_t length, then that many characters of its name
+//   Lifecycle_trace_footer
+struct Lifecycle_record {
+    std::uint64_t time_ns;   // Since lifecycle_trace_start()
+    std::uint64_t object;    // Address of the object
+    std::uint32_t thread;    // Small per-process thread number
+    std::uint16_t type;      // Index into the names section
+    Lifecycle_event event;
+    std::uint8_t reserved;
+};
+
+struct Lifecycle_trace_footer {
+    std::uint64_t names_offset;
+    std::uint32_t type_count;
+    std::uint32_t record_size;
+    char magic[8];           // "LCTRACE1"
+};
+
+static_assert(sizeof(Lifecycle_record) == 24);
+
+namespace lifecycle_detail {
+
+struct Thread_block {
+    std::atomic<std::uint64_t> n[lifecycle_max_types][lifecycle_events] = {};
+    std::mutex m;                           // Guards pending; taken after Registry::m, never before it
+    std::vector<Lifecycle_record> pending;  // Trace records not yet written
+    std::uint32_t thread = 0;
+};
+
+struct Registry {
+    std::mutex m;
+    std::vector<std::string> names;
+    std::vector<Thread_block*> live;
+    std::array<Lifecycle_counts, lifecycle_max_types> retired{};  // From threads that have exited
+    std::uint32_t next_thread = 0;
+    bool dropped_types = false;   // A type was not registered (limit reached, or out of memory)
+
+    // tracing is set (release) after trace_file and trace_start, so an event
+    // that sees it set (acquire) also sees them
+    std::atomic<bool> tracing{false};
+    std::FILE* trace_file = nullptr;
+    std::chrono::steady_clock::time_point trace_start;
+
+    static Registry& get() {
+        static Registry r;
+        return r;
+    }
+};
+
+// Call with the registry and b locked
+inline void write_pending(Registry& r, Thread_block& b) {
+    if (r.trace_file && !b.pending.empty())
+        std::fwrite(b.pending.data(), sizeof(Lifecycle_record), b.pending.size(), r.trace_file);
+    b.pending.clear();
+}
+
+// The calling thread's block: null before it is set up, if it could not be,
+// and once the thread's thread_locals are being destroyed
+inline thread_local Thread_block* current = nullptr;
+inline thread_local bool thread_done = false;
+
+// Registers the calling thread's block; on thread exit its counts move to retired
+struct Thread_holder {
+    Thread_block* b = nullptr;
+
+    Thread_holder() noexcept {
+        try {
+            auto p = std::make_unique<Thread_block>();
+            p->pending.reserve(lifecycle_trace_batch);
+            Registry& r = Registry::get();
+            std::lock_guard<std::mutex> lock{r.m};
+            r.live.push_back(p.get());
+            p->thread = r.next_thread++;
+            b = p.release();
+        }
+        catch (...) {
+        }
+        current = b;
+    }
+
+    ~Thread_holder() {
+        current = nullptr;
+        thread_done = true;
+        if (!b) return;
+        Registry& r = Registry::get();
+        std::lock_guard<std::mutex> lock{r.m};
+        {
+            std::lock_guard<std::mutex> block_lock{b->m};
+            write_pending(r, *b);
+        }
+        for (int t = 0; t != lifecycle_max_types; ++t)
+            for (int e = 0; e != lifecycle_events; ++e)
+                r.retired[t][e] += b->n[t][e].load(std::memory_order_relaxed);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), b));
+        delete b;
+    }
+};
+
+inline Thread_block* local() noexcept {
+    if (!current && !thread_done) {
+        thread_local Thread_holder h;
+    }
+    return current;
+}
+
+inline std::string demangle(const char* name) {
+#ifdef LIFECYCLE_HAVE_CXXABI
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> p{abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free};
+    if (status == 0 && p) return p.get();
+#endif
+    return name;
+}
+
+// -1 if the type cannot be registered; its events are then not counted
+inline int register_type(const char* mangled) noexcept {
+    Registry& r = Registry::get();
+    try {
+        std::lock_guard<std::mutex> lock{r.m};
+        if (r.names.size() == lifecycle_max_types) {
+            r.dropped_types = true;
+            return -1;
+        }
+        r.names.push_back(demangle(mangled));
+        return static_cast<int>(r.names.size()) - 1;
+    }
+    catch (...) {
+        r.dropped_types = true;   // Only bad_alloc from demangle (the name is not pushed)
+        return -1;
+    }
+}
+
+template<typename T>
+int type_id() noexcept {
+    static const int id = register_type(typeid(T).name());
+    return id;
+}
+
+// Called after tracing was seen set. tracing is checked again under b's lock:
+// lifecycle_trace_stop() clears it before it takes each block's lock to flush
+// it, so a record made as tracing stops is dropped rather than written late,
+// and trace_start is read from the session that is running.
+// pending never grows past the capacity reserved for it, so pushing does not allocate.
+inline void trace(Thread_block& b, int type, Lifecycle_event e, const void* object) noexcept {
+    Registry& r = Registry::get();
+    try {
+        bool full;
+        {
+            std::lock_guard<std::mutex> block_lock{b.m};
+            if (!r.tracing.load(std::memory_order_acquire) || b.pending.size() == b.pending.capacity()) return;
+            const auto now = std::chrono::steady_clock::now() - r.trace_start;
+            b.pending.push_back({static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()),
+                                 reinterpret_cast<std::uintptr_t>(object), b.thread, static_cast<std::uint16_t>(type), e, 0});
+            full = b.pending.size() == b.pending.capacity();
+        }
+        if (full) {
+            std::lock_guard<std::mutex> lock{r.m};
+            std::lock_guard<std::mutex> block_lock{b.m};
+            write_pending(r, b);
+        }
+    }
+    catch (...) {   // std::system_error from a mutex: the record is lost
+    }
+}
+
+} // namespace lifecycle_detail
+
+template<typename T>
+void lifecycle_record(Lifecycle_event e, const void* object) noexcept {
+    using namespace lifecycle_detail;
+    Thread_block* b = local();
+    const int t = type_id<T>();
+    if (!b || t < 0) return;
+    auto& c = b->n[t][static_cast<int>(e)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);  // Only this thread writes c
+    if (Registry::get().tracing.load(std::memory_order_acquire))
+        trace(*b, t, e, object);
+}
+
+namespace lifecycle_detail {
+
+// Call with the registry locked
+inline Lifecycle_counts sum(Registry& r, std::size_t type) {
+    Lifecycle_counts c = r.retired[type];
+    for (Thread_block* b : r.live)
+        for (int e = 0; e != lifecycle_events; ++e)
+            c[e] += b->n[type][e].load(std::memory_order_relaxed);
+    return c;
+}
+
+} // namespace lifecycle_detail
+
+// Counts so far for every traced type, summed over all threads
+inline std::vector<Lifecycle_totals> lifecycle_totals() {
+    using namespace lifecycle_detail;
+    Registry& r = Registry::get();
+    std::lock_guard<std::mutex> lock{r.m};
+    std::vector<Lifecycle_totals> v;
+    for (std::size_t t = 0; t != r.names.size(); ++t)
+        v.push_back({r.names[t], sum(r, t)});
+    return v;
+}
+
+// Counts so far for T, summed over all threads
+template<typename T>
+Lifecycle_counts lifecycle_counts() {
+    using namespace lifecycle_detail;
+    const int t = type_id<T>();
+    if (t < 0) return {};
+    Registry& r = Registry::get();
+    std::lock_guard<std::mutex> lock{r.m};
+    return sum(r, static_cast<std::size_t>(t));
+}
+
+inline void lifecycle_report(std::ostream& os) {
+    os << "lifecycle counts:\n";
+    for (const auto& t : lifecycle_totals()) {
+        os << "  " << t.type << '\n' << "   ";
+        for (int e = 0; e != lifecycle_events; ++e)
+            os << ' ' << lifecycle_event_names[e] << ' ' << t.counts[e];
+        os << '\n';
+    }
+    lifecycle_detail::Registry& r = lifecycle_detail::Registry::get();
+    std::lock_guard<std::mutex> lock{r.m};
+    if (r.dropped_types) os << "  (some types were not counted: more than " << lifecycle_max_types << " traced types)\n";
+}
+
+// Start writing every event to a binary trace file at path
+inline void lifecycle_trace_start(const std::string& path) {
+    using namespace lifecycle_detail;
+    Registry& r = Registry::get();
+    std::lock_guard<std::mutex> lock{r.m};
+    if (r.trace_file) throw std::logic_error("lifecycle_trace_start: already tracing");
+    r.trace_file = std::fopen(path.c_str(), "wb");
+    if (!r.trace_file) throw std::runtime_error("lifecycle_trace_start: cannot open " + path);
+    std::fwrite("LCTRACE1", 1, 8, r.trace_file);
+    r.trace_start = std::chrono::steady_clock::now();
+    r.tracing.store(true, std::memory_order_release);
+}
+
+// Finish the trace file. Events that other threads record while it runs
+// are either written or dropped; none is written after the file is closed.
+inline void lifecycle_trace_stop() {
+    using namespace lifecycle_detail;
+    Registry& r = Registry::get();
+    std::lock_guard<std::mutex> lock{r.m};
+    if (!r.trace_file) return;
+    r.tracing.store(false, std::memory_order_relaxed);
+    for (Thread_block* b : r.live) {
+        std::lock_guard<std::mutex> block_lock{b->m};
+        write_pending(r, *b);
+    }
+    Lifecycle_trace_footer f{};
+    f.names_offset = static_cast<std::uint64_t>(std::ftell(r.trace_file));
+    f.type_count = static_cast<std::uint32_t>(r.names.size());
+    f.record_size = sizeof(Lifecycle_record);
+    std::memcpy(f.magic, "LCTRACE1", 8);
+    for (const auto& n : r.names) {
+        const auto len = static_cast<std::uint32_t>(n.size());
+        std::fwrite(&len, sizeof len, 1, r.trace_file);
+        std::fwrite(n.data(), 1, len, r.trace_file);
+    }
+    std::fwrite(&f, sizeof f, 1, r.trace_file);
+    std::fclose(r.trace_file);
+    r.trace_file = nullptr;
+}
+
+// The CRTP mixin
+#if LIFECYCLE_TRACING
+
+template<typename T>
+class Traced {
+protected:
+    Traced() noexcept { lifecycle_record<T>(Lifecycle_event::construct, this); }
+    Traced(const Traced&) noexcept { lifecycle_record<T>(Lifecycle_event::copy_construct, this); }
+    Traced(Traced&&) noexcept { lifecycle_record<T>(Lifecycle_event::move_construct, this); }
+    ~Traced() { lifecycle_record<T>(Lifecycle_event::destroy, this); }
+
+    Traced& operator=(const Traced&) noexcept {
+        lifecycle_record<T>(Lifecycle_event::copy_assign, this);
+        return *this;
+    }
+
+    Traced& operator=(Traced&&) noexcept {
+        lifecycle_record<T>(Lifecycle_event::move_assign, this);
+        return *this;
+    }
+
+    void traced_allocation() const noexcept { lifecycle_record<T>(Lifecycle_event::allocate, this); }
+    void traced_deallocation() const noexcept { lifecycle_record<T>(Lifecycle_event::deallocate, this); }
+};
+
+#else
+
+template<typename T>
+class Traced {
+protected:
+    void traced_allocation() const noexcept {}
+    void traced_deallocation() const noexcept {}
+};
+
+#endif
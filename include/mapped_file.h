@@ -0,0 +1,78 @@
+// mapped_file.h
+// A whole file, read-only, as one contiguous block of chars: memory-mapped
+// where POSIX mmap is available, and read into memory otherwise. Either way
+// data() is suitably aligned for any fundamental type.
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <memory>
+#endif
+
+class Mapped_file {
+private:
+    const char* p = nullptr;
+    std::size_t sz = 0;
+#ifndef MAPPED_FILE_MMAP
+    std::unique_ptr<char[]> copy;   // Not std::string: a short one stores its chars unaligned, inside itself
+#endif
+
+public:
+    explicit Mapped_file(const std::string& path) {
+#ifdef MAPPED_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "Mapped_file: " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "Mapped_file: " + path);
+        }
+        sz = static_cast<std::size_t>(st.st_size);
+        if (sz) {
+            void* m = ::mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) {
+                int e = errno;
+                ::close(fd);
+                throw std::system_error(e, std::generic_category(), "Mapped_file: " + path);
+            }
+            ::madvise(m, sz, MADV_SEQUENTIAL);
+            p = static_cast<const char*>(m);
+        }
+        ::close(fd);  // The mapping stays valid
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) throw std::runtime_error("Mapped_file: cannot open " + path);
+        sz = static_cast<std::size_t>(in.tellg());
+        copy = std::make_unique<char[]>(sz);
+        in.seekg(0);
+        if (!in.read(copy.get(), static_cast<std::streamsize>(sz))) throw std::runtime_error("Mapped_file: cannot read " + path);
+        p = copy.get();
+#endif
+    }
+
+    ~Mapped_file() {
+#ifdef MAPPED_FILE_MMAP
+        if (p) ::munmap(const_cast<char*>(p), sz);
+#endif
+    }
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+
+    const char* data() const { return p; }
+    std::size_t size() const { return sz; }
+};
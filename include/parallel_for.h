@@ -0,0 +1,44 @@
+// parallel_for.h
+// Splitting a loop over [0, n) across threads.
+//
+// Threads are a resource like any other: when one cannot be started, its
+// piece of the work runs on the calling thread instead, and every thread
+// that was started is joined before parallel_for() returns or throws.
+
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Joins every thread in a pool when it goes out of scope, however the scope is left
+struct Join_all {
+    std::vector<std::thread>& pool;
+    ~Join_all() {
+        for (auto& t : pool) t.join();
+    }
+};
+
+// Run f(begin, end) over [0, n) split into `threads` contiguous pieces.
+// A piece whose thread cannot be started runs on the calling thread.
+template<typename F>
+void parallel_for(int n, int threads, F f) {
+    if (threads <= 1 || n < 2) {
+        f(0, n);
+        return;
+    }
+    threads = std::min(threads, n);
+    auto piece = [&](int t) { return static_cast<int>(static_cast<long long>(n) * t / threads); };
+    std::vector<std::thread> pool;
+    Join_all join_all{pool};
+    int started = 1;
+    try {
+        pool.reserve(threads - 1);
+        for (; started != threads; ++started)
+            pool.emplace_back(f, piece(started), piece(started + 1));
+    } catch (...) {  // std::system_error (or bad_alloc): out of threads
+    }
+    for (int t = started; t != threads; ++t) f(piece(t), piece(t + 1));
+    f(0, piece(1));
+}
+
@@ -0,0 +1,25 @@
+// range_checking.h
+// Range checking policy for the subscript operators of the Vector classes.
+//
+// The default for every Vector is chosen at compile time with
+// -DVECTOR_CHECKING=checked|debug_only|unchecked (default: checked);
+// debug_only checks unless NDEBUG is defined. at() always checks.
+
+#pragma once
+
+enum class Checking { checked, debug_only, unchecked };
+
+#ifndef VECTOR_CHECKING
+#define VECTOR_CHECKING checked
+#endif
+
+#ifdef NDEBUG
+constexpr bool debug_build = false;
+#else
+constexpr bool debug_build = true;
+#endif
+
+constexpr Checking vector_checking = Checking::VECTOR_CHECKING;
+
+template<Checking C>
+constexpr bool check_subscripts = C == Checking::checked || (C == Checking::debug_only && debug_build);
@@ -0,0 +1,183 @@
+// vector_file.h
+// The binary Vector file format shared by the ch05 and ch07 Vectors.
+//
+// A 64-byte header followed by the elements as raw native-format values.
+// The header records what the elements are and how many there are, so a
+// file can be mapped and used in place: no copying and no parsing.
+//
+//   save(span, path)         writes a file
+//   Mapped_vector<T>         reads one in place
+//   Vector_appender<T>       adds elements to one, creating it if needed
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "mapped_file.h"
+#include "range_checking.h"
+
+enum class Element_type : std::uint32_t { f32 = 1, f64 = 2, i32 = 3, i64 = 4 };
+
+struct Vector_file_header {
+    char magic[8];               // "TOURVEC" and a '\0'
+    std::uint32_t version;       // vector_file_version
+    std::uint32_t byte_order;    // 0x01020304 as stored by the machine that wrote the file
+    Element_type elem_type;
+    std::uint32_t elem_size;     // Bytes per element
+    std::uint32_t alignment;     // Offset of the first element (the header size)
+    std::uint32_t reserved;
+    std::uint64_t count;         // Number of elements
+    std::uint64_t checksum;      // FNV-1a of the element bytes
+    char pad[16];
+};
+
+static_assert(sizeof(Vector_file_header) == 64);
+constexpr std::uint32_t vector_file_version = 1;
+constexpr std::uint64_t fnv_offset = 14695981039346656037ull;
+
+template<typename T>
+constexpr Element_type element_type_of() {
+    if constexpr (std::is_same_v<T, float>) return Element_type::f32;
+    else if constexpr (std::is_same_v<T, double>) return Element_type::f64;
+    else if constexpr (std::is_same_v<T, std::int32_t>) return Element_type::i32;
+    else if constexpr (std::is_same_v<T, std::int64_t>) return Element_type::i64;
+    else static_assert(sizeof(T) == 0, "no Vector file element type for T");
+}
+
+// FNV-1a, continuing from h, so a checksum can be extended as data is appended
+inline std::uint64_t fnv1a(const void* p, std::size_t n, std::uint64_t h = fnv_offset) {
+    auto b = static_cast<const unsigned char*>(p);
+    for (std::size_t i = 0; i != n; ++i) {
+        h ^= b[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+template<typename T>
+Vector_file_header make_header(std::uint64_t count, std::uint64_t checksum) {
+    Vector_file_header h{};
+    std::memcpy(h.magic, "TOURVEC", 8);
+    h.version = vector_file_version;
+    h.byte_order = 0x01020304;
+    h.elem_type = element_type_of<T>();
+    h.elem_size = sizeof(T);
+    h.alignment = sizeof(Vector_file_header);
+    h.count = count;
+    h.checksum = checksum;
+    return h;
+}
+
+// Throws unless h describes Ts this program can use in place
+template<typename T>
+void check_header(const Vector_file_header& h, std::size_t file_size, const std::string& path) {
+    auto fail = [&](const char* what) { throw std::runtime_error("Vector file " + path + ": " + what); };
+    if (file_size < sizeof h || std::memcmp(h.magic, "TOURVEC", 8) != 0) fail("not a Vector file");
+    if (h.version != vector_file_version) fail("unsupported version");
+    if (h.byte_order != 0x01020304) fail("written with a different byte order");
+    if (h.elem_type != element_type_of<T>() || h.elem_size != sizeof(T)) fail("wrong element type");
+    if (h.alignment < sizeof h || h.alignment % alignof(T) != 0) fail("bad alignment");
+    if (h.alignment > file_size) fail("truncated");
+    if (h.count > (file_size - h.alignment) / sizeof(T)) fail("truncated");
+}
+
+template<typename T>
+void save(std::span<const T> s, const std::string& path) {
+    const Vector_file_header h = make_header<T>(s.size(), fnv1a(s.data(), s.size_bytes()));
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&h), sizeof h);
+    out.write(reinterpret_cast<const char*>(s.data()), static_cast<std::streamsize>(s.size_bytes()));
+    if (!out) throw std::runtime_error("save: cannot write " + path);
+}
+
+// A read-only view of a Vector file's elements, used in place in the mapped file
+template<typename T>
+class Mapped_vector {
+private:
+    Mapped_file f;
+    const Vector_file_header* h;
+
+public:
+    explicit Mapped_vector(const std::string& path)
+        : f{path}, h{reinterpret_cast<const Vector_file_header*>(f.data())} {
+        check_header<T>(*h, f.size(), path);
+    }
+
+    std::size_t size() const { return h->count; }
+    const T* data() const { return reinterpret_cast<const T*>(f.data() + h->alignment); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    const T& operator[](std::size_t i) const {
+        if constexpr (check_subscripts<vector_checking>)
+            if (i >= size()) throw std::out_of_range("Mapped_vector::operator[]");
+        return data()[i];
+    }
+
+    // Reads every element, so it is not done on open
+    bool verify() const { return fnv1a(data(), size() * sizeof(T)) == h->checksum; }
+};
+
+// Appends elements to a Vector file, creating it if needed. The header's count
+// and checksum are brought up to date by flush() and by the destructor.
+template<typename T>
+class Vector_appender {
+private:
+    std::fstream file;
+    std::string path;
+    Vector_file_header h;
+    std::vector<T> buf;
+
+public:
+    explicit Vector_appender(const std::string& p) : path{p} {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file) {
+            save(std::span<const T>{}, path);
+            file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        }
+        file.seekg(0, std::ios::end);
+        const auto file_size = static_cast<std::size_t>(file.tellg());
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(&h), sizeof h)) throw std::runtime_error("Vector_appender: cannot read " + path);
+        check_header<T>(h, file_size, path);
+        buf.reserve((512 * 1024) / sizeof(T));
+    }
+
+    ~Vector_appender() {
+        try { flush(); } catch (...) {}  // Destructors must not throw; call flush() to see errors
+    }
+
+    Vector_appender(const Vector_appender&) = delete;
+    Vector_appender& operator=(const Vector_appender&) = delete;
+
+    void push_back(const T& x) {
+        buf.push_back(x);
+        if (buf.size() == buf.capacity()) flush();
+    }
+
+    void append(std::span<const T> s) {
+        for (const T& x : s) push_back(x);
+    }
+
+    void flush() {
+        if (buf.empty()) return;
+        const auto bytes = buf.size() * sizeof(T);
+        file.seekp(static_cast<std::streamoff>(h.alignment + h.count * sizeof(T)));
+        file.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(bytes));
+        h.count += buf.size();
+        h.checksum = fnv1a(buf.data(), bytes, h.checksum);
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&h), sizeof h);
+        file.flush();
+        if (!file) throw std::runtime_error("Vector_appender: cannot write " + path);
+        buf.clear();
+    }
+};
@@ -7,153 +7,377 @@
 #include <memory>
 #include <stdexcept>
 #include <initializer_list>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <functional>
+#include <span>
+#include <cmath>
+#include <numbers>
+#include <variant>
+#include <type_traits>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <fstream>
+#include <complex>
+#include <thread>
+#include <filesystem>
+
+#include "lifecycle_trace.h"
+#include "range_checking.h"
+#include "vector_file.h"
+
+#include "fft.h"
+#include "point.h"
+#include "point_kernels.h"
+#include "read_numbers.h"
+#include "render_sinks.h"
 
 // ==========================================
 // PART 1: CONCRETE TYPES
 // ==========================================
 
 // 1.1 An Arithmetic Type Example - Complex Number Class
+// Copying is left to the compiler, so Complex is trivially copyable and
+// containers can move it around with memcpy.
 class Complex {
 private:
     double re, im;  // representation: two doubles
 
 public:
     // Constructors
-    Complex(double r, double i) : re{r}, im{i} {}           // construct from two scalars
-    Complex(double r) : re{r}, im{0} {}                     // construct from one scalar
-    Complex() : re{0}, im{0} {}                             // default complex: {0,0}
-    Complex(const Complex& z) : re{z.re}, im{z.im} {}       // copy constructor
+    constexpr Complex(double r, double i) : re{r}, im{i} {}  // construct from two scalars
+    constexpr Complex(double r) : re{r}, im{0} {}            // construct from one scalar
+    constexpr Complex() : re{0}, im{0} {}                    // default complex: {0,0}
 
     // Accessors
-    double real() const { return re; }
-    void real(double d) { re = d; }
-    double imag() const { return im; }
-    void imag(double d) { im = d; }
+    constexpr double real() const { return re; }
+    constexpr void real(double d) { re = d; }
+    constexpr double imag() const { return im; }
+    constexpr void imag(double d) { im = d; }
 
     // Operators
-    Complex& operator+=(const Complex& z) {
+    constexpr Complex& operator+=(const Complex& z) {
         re += z.re;
         im += z.im;
         return *this;
     }
 
-    Complex& operator-=(const Complex& z) {
+    constexpr Complex& operator-=(const Complex& z) {
         re -= z.re;
         im -= z.im;
         return *this;
     }
 
-    // Multiplication and division would be defined here
+    constexpr Complex& operator*=(const Complex& z) {
+        const double r = re * z.re - im * z.im;
+        im = re * z.im + im * z.re;
+        re = r;
+        return *this;
+    }
+
+    constexpr Complex& operator/=(const Complex& z) {
+        const double d = z.re * z.re + z.im * z.im;
+        const double r = (re * z.re + im * z.im) / d;
+        im = (im * z.re - re * z.im) / d;
+        re = r;
+        return *this;
+    }
 };
 
+static_assert(std::is_trivially_copyable_v<Complex>);
+
 // Non-member operators for Complex
-Complex operator+(Complex a, const Complex& b) {
+constexpr Complex operator+(Complex a, const Complex& b) {
     return a += b;  // Use already defined += and return the result
 }
 
-Complex operator-(Complex a, const Complex& b) {
+constexpr Complex operator-(Complex a, const Complex& b) {
     return a -= b;  // Use already defined -= and return the result
 }
 
-Complex operator-(Complex a) {
+constexpr Complex operator*(Complex a, const Complex& b) {
+    return a *= b;
+}
+
+constexpr Complex operator/(Complex a, const Complex& b) {
+    return a /= b;
+}
+
+constexpr Complex operator-(Complex a) {
     return {-a.real(), -a.imag()};  // Unary minus
 }
 
-bool operator==(const Complex& a, const Complex& b) {
+constexpr bool operator==(const Complex& a, const Complex& b) {
     return a.real() == b.real() && a.imag() == b.imag();
 }
 
-bool operator!=(const Complex& a, const Complex& b) {
+constexpr bool operator!=(const Complex& a, const Complex& b) {
     return !(a == b);
 }
 
+constexpr Complex conj(Complex z) { return {z.real(), -z.imag()}; }
+constexpr double norm(Complex z) { return z.real() * z.real() + z.imag() * z.imag(); }  // |z|^2
+double abs(Complex z) { return std::hypot(z.real(), z.imag()); }
+double arg(Complex z) { return std::atan2(z.imag(), z.real()); }
+Complex polar(double r, double theta) { return {r * std::cos(theta), r * std::sin(theta)}; }
+Complex exp(Complex z) { return polar(std::exp(z.real()), z.imag()); }
+
+static_assert(Complex{1, 2} * Complex{3, 4} == Complex{-5, 10});
+static_assert(Complex{-5, 10} / Complex{3, 4} == Complex{1, 2});
+
+// 1.1.1 Arrays of complex numbers with split real/imaginary storage.
+// Keeping all real parts together and all imaginary parts together turns
+// complex arithmetic into plain loops over double arrays, which compilers
+// vectorize without shuffling interleaved pairs.
+class ComplexArray {
+private:
+    std::vector<double> re, im;
+
+public:
+    ComplexArray() = default;
+    explicit ComplexArray(int n) : re(n), im(n) {}
+
+    int size() const { return static_cast<int>(re.size()); }
+    Complex operator[](int i) const { return {re[i], im[i]}; }
+    void set(int i, Complex z) { re[i] = z.real(); im[i] = z.imag(); }
+
+    double* real() { return re.data(); }
+    double* imag() { return im.data(); }
+    const double* real() const { return re.data(); }
+    const double* imag() const { return im.data(); }
+};
+
+// Element-wise out = a op b; all arrays must have the same size
+void add(const ComplexArray& a, const ComplexArray& b, ComplexArray& out) {
+    const int n = out.size();
+    const double *ar = a.real(), *ai = a.imag(), *br = b.real(), *bi = b.imag();
+    double *or_ = out.real(), *oi = out.imag();
+    for (int i = 0; i != n; ++i) {
+        or_[i] = ar[i] + br[i];
+        oi[i] = ai[i] + bi[i];
+    }
+}
+
+void mul(const ComplexArray& a, const ComplexArray& b, ComplexArray& out) {
+    const int n = out.size();
+    const double *ar = a.real(), *ai = a.imag(), *br = b.real(), *bi = b.imag();
+    double *or_ = out.real(), *oi = out.imag();
+    for (int i = 0; i != n; ++i) {
+        const double r = ar[i] * br[i] - ai[i] * bi[i];
+        const double m = ar[i] * bi[i] + ai[i] * br[i];
+        or_[i] = r;
+        oi[i] = m;
+    }
+}
+
+// Multiply-accumulate: acc[i] += a[i] * b[i]
+void mul_add(const ComplexArray& a, const ComplexArray& b, ComplexArray& acc) {
+    const int n = acc.size();
+    const double *ar = a.real(), *ai = a.imag(), *br = b.real(), *bi = b.imag();
+    double *cr = acc.real(), *ci = acc.imag();
+    for (int i = 0; i != n; ++i) {
+        cr[i] += ar[i] * br[i] - ai[i] * bi[i];
+        ci[i] += ar[i] * bi[i] + ai[i] * br[i];
+    }
+}
+
+// Sum of a[i] * b[i] (no conjugation). Four independent partial sums keep
+// the floating-point adds from forming one long dependency chain.
+Complex dot(const ComplexArray& a, const ComplexArray& b) {
+    const int n = a.size();
+    const double *ar = a.real(), *ai = a.imag(), *br = b.real(), *bi = b.imag();
+    double sr[4] = {}, si[4] = {};
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        for (int k = 0; k != 4; ++k) {
+            sr[k] += ar[i + k] * br[i + k] - ai[i + k] * bi[i + k];
+            si[k] += ar[i + k] * bi[i + k] + ai[i + k] * br[i + k];
+        }
+    for (; i != n; ++i) {
+        sr[0] += ar[i] * br[i] - ai[i] * bi[i];
+        si[0] += ar[i] * bi[i] + ai[i] * br[i];
+    }
+    return {(sr[0] + sr[1]) + (sr[2] + sr[3]), (si[0] + si[1]) + (si[2] + si[3])};
+}
+
+// 1.1.2 Fast Fourier transform: fft(), ifft() and naive_dft() over Complex are in fft.h
+
 // 1.2 A Container Example - Vector class with RAII
-class Vector {
+// Copies, moves and buffer allocations are counted by Traced (lifecycle_trace.h).
+class Vector : private Traced<Vector> {
 private:
     double* elem;  // pointer to elements
-    int sz;        // size
+    int sz;        // number of elements
+    int space;     // number of elements plus free space (capacity)
 
 public:
     // Default constructor
-    Vector() : elem{nullptr}, sz{0} {}
+    Vector() : elem{nullptr}, sz{0}, space{0} {}
     
     // Constructor (acquires resources)
-    Vector(int s) : elem{new double[s]}, sz{s} {
+    Vector(int s) : elem{allocate(s)}, sz{s}, space{s} {
         for (int i = 0; i != s; ++i)
             elem[i] = 0;  // Initialize elements
     }
 
     // Destructor (releases resources)
     ~Vector() {
-        delete[] elem;  // Free memory
+        release(elem);  // Free memory
     }
 
-    // Copy constructor
-    Vector(const Vector& other) : elem{new double[other.sz]}, sz{other.sz} {
+    // Copy constructor (the copy is sized exactly, without the source's free space)
+    Vector(const Vector& other) : Traced<Vector>(other), elem{allocate(other.sz)}, sz{other.sz}, space{other.sz} {
         for (int i = 0; i != sz; ++i)
             elem[i] = other.elem[i];
     }
 
     // Copy assignment
     Vector& operator=(const Vector& other) {
+        Traced<Vector>::operator=(other);
         if (this != &other) {
-            double* p = new double[other.sz];
+            if (other.sz <= space) {  // Enough room: reuse our own buffer
+                std::copy(other.elem, other.elem + other.sz, elem);
+                sz = other.sz;
+                return *this;
+            }
+            double* p = allocate(other.sz);
             for (int i = 0; i != other.sz; ++i)
                 p[i] = other.elem[i];
-            delete[] elem;
+            release(elem);
             elem = p;
             sz = other.sz;
+            space = other.sz;
         }
         return *this;
     }
 
     // Move constructor (C++11 and later)
-    Vector(Vector&& other) noexcept : elem{other.elem}, sz{other.sz} {
+    Vector(Vector&& other) noexcept : Traced<Vector>(std::move(other)), elem{other.elem}, sz{other.sz}, space{other.space} {
         other.elem = nullptr;
         other.sz = 0;
+        other.space = 0;
     }
 
     // Move assignment (C++11 and later)
     Vector& operator=(Vector&& other) noexcept {
+        Traced<Vector>::operator=(std::move(other));
         if (this != &other) {
-            delete[] elem;
+            release(elem);
             elem = other.elem;
             sz = other.sz;
+            space = other.space;
             other.elem = nullptr;
             other.sz = 0;
+            other.space = 0;
         }
         return *this;
     }
 
     // Initializer list constructor
     Vector(std::initializer_list<double> lst)
-        : elem{new double[lst.size()]}, sz{static_cast<int>(lst.size())} {
+        : elem{allocate(static_cast<int>(lst.size()))}, sz{static_cast<int>(lst.size())}, space{sz} {
         std::copy(lst.begin(), lst.end(), elem);  // Copy from lst into elem
     }
 
-    // Add element at the end
-    void push_back(double d) {
-        double* p = new double[sz + 1];
-        for (int i = 0; i != sz; ++i)
-            p[i] = elem[i];
-        p[sz] = d;
-        delete[] elem;
+    // Make room for at least n elements; never shrinks
+    void reserve(int n) {
+        if (n <= space) return;
+        double* p = allocate(n);
+        std::copy(elem, elem + sz, p);
+        release(elem);
+        elem = p;
+        space = n;
+    }
+
+    // Give back the free space so that capacity() == size()
+    void shrink_to_fit() {
+        if (sz == space) return;
+        double* p = sz ? allocate(sz) : nullptr;
+        std::copy(elem, elem + sz, p);
+        release(elem);
         elem = p;
-        ++sz;
+        space = sz;
     }
 
-    // Access functions
+    // Add element at the end.
+    // Capacity grows geometrically (doubling), so a sequence of n push_backs
+    // costs O(n) element copies in total instead of O(n^2).
+    void push_back(double d) {
+        if (sz == space) grow();
+        elem[sz++] = d;
+    }
+
+    // Construct an element in place at the end and return a reference to it.
+    // The value is built before grow(), since args may refer to an element
+    // of this Vector (v.emplace_back(v[0])) that grow() frees.
+    template<typename... Args>
+    double& emplace_back(Args&&... args) {
+        double tmp(std::forward<Args>(args)...);
+        if (sz == space) grow();
+        elem[sz] = tmp;
+        return elem[sz++];
+    }
+
+    // Access functions (checked according to vector_checking)
     double& operator[](int i) {
-        if (i < 0 || i >= sz) throw std::out_of_range("Vector::operator[]");
+        if constexpr (check_subscripts<vector_checking>)
+            if (i < 0 || i >= sz) throw std::out_of_range("Vector::operator[]");
         return elem[i];
     }
 
     const double& operator[](int i) const {
-        if (i < 0 || i >= sz) throw std::out_of_range("Vector::operator[]");
+        if constexpr (check_subscripts<vector_checking>)
+            if (i < 0 || i >= sz) throw std::out_of_range("Vector::operator[]");
+        return elem[i];
+    }
+
+    // Always range checked
+    double& at(int i) {
+        if (i < 0 || i >= sz) throw std::out_of_range("Vector::at");
+        return elem[i];
+    }
+
+    const double& at(int i) const {
+        if (i < 0 || i >= sz) throw std::out_of_range("Vector::at");
         return elem[i];
     }
 
+    // Contiguous storage: plain pointers are contiguous iterators,
+    // so loops over [begin(), end()) compile to straight-line, vectorizable code
+    double* data() { return elem; }
+    const double* data() const { return elem; }
+    double* begin() { return elem; }
+    double* end() { return elem + sz; }
+    const double* begin() const { return elem; }
+    const double* end() const { return elem + sz; }
+
     int size() const { return sz; }
+    int capacity() const { return space; }
+
+private:
+    // Every buffer goes through these, so that allocations are counted
+    double* allocate(int n) {
+        traced_allocation();
+        return new double[n];
+    }
+
+    void release(double* p) {
+        if (p) traced_deallocation();
+        delete[] p;
+    }
+
+    // Double the capacity (starting at 8), saturating at the largest int
+    void grow() {
+        constexpr int max = std::numeric_limits<int>::max();
+        if (space == max) throw std::length_error("Vector::push_back");
+        reserve(space == 0 ? 8 : (space > max / 2 ? max : 2 * space));
+    }
 };
 
 // Function to read values into a Vector
@@ -164,16 +388,55 @@ Vector read(std::istream& is) {
     return v;  // Return by value (move semantics make this efficient)
 }
 
+// 1.3 Fast numeric input: read_fast() and read_file() are in read_numbers.h
+
+// 1.4 Binary Vector files
+// The format (a 64-byte header, then the raw doubles), Mapped_vector<double>
+// for using a file in place and Vector_appender<double> are in vector_file.h
+
+void save(const Vector& v, const std::string& path) {
+    save(std::span<const double>{v.data(), static_cast<std::size_t>(v.size())}, path);
+}
+
 // ==========================================
 // PART 2: ABSTRACT TYPES
 // ==========================================
 
 // 2.1 Abstract Container Interface
+
+// Sequential access to the elements of a Container, one at a time.
+// Each container supplies its own cursor, so a full scan is O(n) even where
+// positional access is not O(1).
+class Cursor {
+public:
+    virtual bool done() const = 0;                 // Past the last element?
+    virtual double& get() = 0;                     // Current element
+    virtual void next() = 0;                       // Advance by one
+    virtual ~Cursor() {}
+};
+
 class Container {
 public:
     virtual double& operator[](int) = 0;           // Pure virtual function
     virtual int size() const = 0;                  // Pure virtual function
+    virtual std::unique_ptr<Cursor> cursor() = 0;  // Start a sequential scan
     virtual ~Container() {}                        // Virtual destructor
+
+    // Batch traversal: f is called once per contiguous chunk of elements, in order,
+    // so the per-element work inside f is plain, inlinable, vectorizable code
+    virtual void for_each_span(const std::function<void(std::span<const double>)>& f) const = 0;
+
+    // Copy the first out.size() elements (or all, if fewer) to out; returns the count copied
+    int copy_to(std::span<double> out) const {
+        std::size_t n = 0;
+        for_each_span([&](std::span<const double> s) {
+            if (n == out.size()) return;
+            std::size_t k = std::min(s.size(), out.size() - n);
+            std::copy_n(s.data(), k, out.data() + n);
+            n += k;
+        });
+        return static_cast<int>(n);
+    }
 };
 
 // 2.2 Vector_container implementation using Vector
@@ -181,6 +444,16 @@ class Vector_container : public Container {
 private:
     Vector v;
 
+    class Vector_cursor : public Cursor {
+        double* p;
+        double* e;
+    public:
+        Vector_cursor(Vector& v) : p{v.begin()}, e{v.end()} {}
+        bool done() const override { return p == e; }
+        double& get() override { return *p; }
+        void next() override { ++p; }
+    };
+
 public:
     Vector_container(int s) : v(s) {}
     Vector_container(std::initializer_list<double> il) : v(il) {}
@@ -188,34 +461,102 @@ public:
 
     double& operator[](int i) override { return v[i]; }
     int size() const override { return v.size(); }
+    std::unique_ptr<Cursor> cursor() override { return std::make_unique<Vector_cursor>(v); }
+
+    // The whole buffer in one chunk
+    void for_each_span(const std::function<void(std::span<const double>)>& f) const override {
+        f(std::span<const double>{v.data(), static_cast<std::size_t>(v.size())});
+    }
 };
 
 // 2.3 List_container implementation using std::list
+// Elements live in list nodes, so references to them stay valid across
+// insert() and erase() of other elements. An index of node iterators,
+// kept in element order, makes operator[] O(1) instead of a walk from the head.
 class List_container : public Container {
 private:
-    std::list<double> ld;  // Standard library list of doubles
+    std::list<double> ld;                            // Standard library list of doubles
+    std::vector<std::list<double>::iterator> index;  // index[i] refers to the i-th element
+
+    class List_cursor : public Cursor {
+        std::list<double>::iterator p;
+        std::list<double>::iterator e;
+    public:
+        List_cursor(std::list<double>& l) : p{l.begin()}, e{l.end()} {}
+        bool done() const override { return p == e; }
+        double& get() override { return *p; }
+        void next() override { ++p; }
+    };
 
 public:
     List_container() = default;
-    List_container(std::initializer_list<double> il) : ld{il} {}
+    List_container(std::initializer_list<double> il) : ld{il} {
+        index.reserve(ld.size());
+        for (auto p = ld.begin(); p != ld.end(); ++p)
+            index.push_back(p);
+    }
     ~List_container() override {}
 
+    // The index holds iterators into ld, so a copy would refer to the wrong list
+    List_container(const List_container&) = delete;
+    List_container& operator=(const List_container&) = delete;
+
     double& operator[](int i) override {
-        for (auto& x : ld) {
-            if (i == 0) return x;
-            --i;
-        }
-        throw std::out_of_range("List_container::operator[]");
+        if (i < 0 || i >= size()) throw std::out_of_range("List_container::operator[]");
+        return *index[i];
     }
 
     int size() const override { return static_cast<int>(ld.size()); }
+    std::unique_ptr<Cursor> cursor() override { return std::make_unique<List_cursor>(ld); }
+
+    // List nodes are not contiguous, so elements are gathered into chunks
+    void for_each_span(const std::function<void(std::span<const double>)>& f) const override {
+        constexpr std::size_t chunk = 256;
+        double buf[chunk];
+        std::size_t n = 0;
+        for (double d : ld) {
+            buf[n++] = d;
+            if (n == chunk) {
+                f(std::span<const double>{buf, n});
+                n = 0;
+            }
+        }
+        if (n) f(std::span<const double>{buf, n});
+    }
+
+    void push_back(double d) {
+        ld.push_back(d);
+        index.push_back(std::prev(ld.end()));
+    }
+
+    // Insert d before position i (i == size() appends); O(n) pointer moves, no list walk
+    double& insert(int i, double d) {
+        if (i < 0 || i > size()) throw std::out_of_range("List_container::insert");
+        auto p = ld.insert(i == size() ? ld.end() : index[i], d);
+        index.insert(index.begin() + i, p);
+        return *p;
+    }
+
+    void erase(int i) {
+        if (i < 0 || i >= size()) throw std::out_of_range("List_container::erase");
+        ld.erase(index[i]);
+        index.erase(index.begin() + i);
+    }
 };
 
 // Function that uses Container interface without knowing implementation
 void use(Container& c) {
-    const int sz = c.size();
-    for (int i = 0; i != sz; ++i)
-        std::cout << c[i] << '\n';
+    for (auto p = c.cursor(); !p->done(); p->next())
+        std::cout << p->get() << '\n';
+}
+
+// Sum a Container chunk by chunk: one virtual call per chunk, not per element
+double sum(const Container& c) {
+    double s = 0;
+    c.for_each_span([&](std::span<const double> chunk) {
+        for (double d : chunk) s += d;
+    });
+    return s;
 }
 
 // ==========================================
@@ -223,17 +564,14 @@ void use(Container& c) {
 // ==========================================
 
 // 3.1 Shape class hierarchy
-class Point {
-public:
-    int x, y;
-    Point(int x = 0, int y = 0) : x{x}, y{y} {}
-};
-
+// Point, Rotation and rotate_point() are in point.h; Render_sink, where shapes
+// draw themselves, and its implementations (3.7) are in render_sinks.h
 class Shape {
 public:
     virtual Point center() const = 0;      // Pure virtual
     virtual void move(Point to) = 0;       // Pure virtual
     virtual void draw() const = 0;         // Pure virtual
+    virtual void draw(Render_sink& s) const = 0;  // Pure virtual
     virtual void rotate(int angle) = 0;    // Pure virtual
     virtual ~Shape() {}                   // Virtual destructor
 };
@@ -253,6 +591,8 @@ public:
         std::cout << "Drawing Circle at (" << p.x << "," << p.y 
                   << ") with radius " << r << std::endl;
     }
+
+    void draw(Render_sink& s) const override { s.circle(p, r); }
     
     void rotate(int) override {
         // Circles remain the same when rotated
@@ -289,9 +629,16 @@ public:
                   << std::endl;
     }
 
+    void draw(Render_sink& s) const override { s.triangle(p1, p2, p3); }
+
     void rotate(int angle) override {
-        // Would implement actual rotation around the center
+        // Rotate the vertices around the center
         std::cout << "Rotating Triangle by " << angle << " degrees" << std::endl;
+        const Point c = center();
+        const Rotation r{static_cast<double>(angle)};
+        p1 = rotate_point(p1, c, r);
+        p2 = rotate_point(p2, c, r);
+        p3 = rotate_point(p3, c, r);
     }
 };
 
@@ -319,6 +666,14 @@ public:
         if (mouth) 
             mouth->draw(); // Draw the mouth
     }
+
+    void draw(Render_sink& s) const override {
+        Circle::draw(s);
+        for (const auto& e : eyes)
+            e->draw(s);
+        if (mouth)
+            mouth->draw(s);
+    }
     
     void move(Point to) override {
         Point old_center = center();
@@ -343,10 +698,16 @@ public:
     void rotate(int angle) override {
         // Rotate the eyes and mouth around the center
         std::cout << "Rotating Smiley by " << angle << " degrees" << std::endl;
+        const Point c = center();
+        const Rotation r{static_cast<double>(angle)};
+        auto turn = [&](Shape& part) {
+            part.move(rotate_point(part.center(), c, r));  // Carry the part around the face
+            part.rotate(angle);                            // and turn it in place
+        };
         for (auto& e : eyes)
-            e->rotate(angle);
+            turn(*e);
         if (mouth)
-            mouth->rotate(angle);
+            turn(*mouth);
     }
 
     void wink(int i) {
@@ -363,6 +724,13 @@ void draw_all(const std::vector<std::unique_ptr<Shape>>& v) {
         p->draw();
 }
 
+// Draw a whole frame into a sink, then deliver it at once
+void draw_all(const std::vector<std::unique_ptr<Shape>>& v, Render_sink& sink) {
+    for (const auto& p : v)
+        p->draw(sink);
+    sink.end_frame();
+}
+
 void rotate_all(std::vector<std::unique_ptr<Shape>>& v, int angle) {
     for (auto& p : v)
         p->rotate(angle);
@@ -400,20 +768,892 @@ std::unique_ptr<Shape> create_shape(ShapeType type) {
     return nullptr;
 }
 
+// 3.3 Bulk point kernels: translate_points() and rotate_points() are in point_kernels.h
+
+// 3.4 Data-oriented shape storage
+// Each concrete shape type lives in its own pool, stored as a structure of
+// arrays (all x coordinates together, all y coordinates together, ...).
+// Whole-store operations run type by type over contiguous arrays with no
+// virtual dispatch; a Shape_handle still names one individual shape.
+// Smileys use the layout create_shape() builds: two round eyes and a triangular mouth.
+struct Shape_handle {
+    ShapeType type;
+    int index;  // position within the pool for type
+};
+
+class ShapeStore {
+private:
+    struct Circles {
+        std::vector<int> x, y, r;
+    } circles;
+
+    struct Triangles {
+        std::vector<int> x[3], y[3];
+    } triangles;
+
+    struct Smileys {
+        std::vector<int> x, y, r;                         // face
+        std::vector<int> eye_x[2], eye_y[2], eye_r[2];    // eyes
+        std::vector<int> mouth_x[3], mouth_y[3];          // mouth
+    } smileys;
+
+    static Point centroid(const std::vector<int> (&x)[3], const std::vector<int> (&y)[3], int i) {
+        return Point{(x[0][i] + x[1][i] + x[2][i]) / 3, (y[0][i] + y[1][i] + y[2][i]) / 3};
+    }
+
+    static void shift(std::vector<int>& x, std::vector<int>& y, int dx, int dy) {
+        translate_points(x.data(), y.data(), x.size(), dx, dy);
+    }
+
+public:
+    Shape_handle add_circle(Point p, int r) {
+        circles.x.push_back(p.x);
+        circles.y.push_back(p.y);
+        circles.r.push_back(r);
+        return {ShapeType::circle, static_cast<int>(circles.x.size()) - 1};
+    }
+
+    Shape_handle add_triangle(Point a, Point b, Point c) {
+        const Point v[3] = {a, b, c};
+        for (int k = 0; k != 3; ++k) {
+            triangles.x[k].push_back(v[k].x);
+            triangles.y[k].push_back(v[k].y);
+        }
+        return {ShapeType::triangle, static_cast<int>(triangles.x[0].size()) - 1};
+    }
+
+    // A face at p with radius r; the parts are placed as in create_shape()
+    Shape_handle add_smiley(Point p, int r) {
+        smileys.x.push_back(p.x);
+        smileys.y.push_back(p.y);
+        smileys.r.push_back(r);
+        const Point eyes[2] = {{p.x - 7, p.y - 7}, {p.x + 7, p.y - 7}};
+        for (int k = 0; k != 2; ++k) {
+            smileys.eye_x[k].push_back(eyes[k].x);
+            smileys.eye_y[k].push_back(eyes[k].y);
+            smileys.eye_r[k].push_back(5);
+        }
+        const Point mouth[3] = {{p.x - 5, p.y + 5}, {p.x + 5, p.y + 5}, {p.x, p.y + 10}};
+        for (int k = 0; k != 3; ++k) {
+            smileys.mouth_x[k].push_back(mouth[k].x);
+            smileys.mouth_y[k].push_back(mouth[k].y);
+        }
+        return {ShapeType::smiley, static_cast<int>(smileys.x.size()) - 1};
+    }
+
+    Shape_handle add(ShapeType type) {
+        switch (type) {
+            case ShapeType::circle:   return add_circle(Point{10, 10}, 20);
+            case ShapeType::triangle: return add_triangle(Point{0, 0}, Point{20, 0}, Point{10, 20});
+            case ShapeType::smiley:   return add_smiley(Point{15, 15}, 30);
+        }
+        throw std::invalid_argument("ShapeStore::add");
+    }
+
+    int size() const {
+        return static_cast<int>(circles.x.size() + triangles.x[0].size() + smileys.x.size());
+    }
+
+    // Access to individual shapes through handles
+    Point center(Shape_handle h) const {
+        switch (h.type) {
+            case ShapeType::circle:   return Point{circles.x[h.index], circles.y[h.index]};
+            case ShapeType::triangle: return centroid(triangles.x, triangles.y, h.index);
+            case ShapeType::smiley:   return Point{smileys.x[h.index], smileys.y[h.index]};
+        }
+        throw std::invalid_argument("ShapeStore::center");
+    }
+
+    void move(Shape_handle h, Point to) {
+        const Point c = center(h);
+        const int dx = to.x - c.x;
+        const int dy = to.y - c.y;
+        const int i = h.index;
+        switch (h.type) {
+            case ShapeType::circle:
+                circles.x[i] += dx; circles.y[i] += dy;
+                break;
+            case ShapeType::triangle:
+                for (int k = 0; k != 3; ++k) {
+                    triangles.x[k][i] += dx; triangles.y[k][i] += dy;
+                }
+                break;
+            case ShapeType::smiley:
+                smileys.x[i] += dx; smileys.y[i] += dy;
+                for (int k = 0; k != 2; ++k) {
+                    smileys.eye_x[k][i] += dx; smileys.eye_y[k][i] += dy;
+                }
+                for (int k = 0; k != 3; ++k) {
+                    smileys.mouth_x[k][i] += dx; smileys.mouth_y[k][i] += dy;
+                }
+                break;
+        }
+    }
+
+    // Whole-store operations, type by type
+    template<typename F>
+    void for_each_center(F f) const {
+        for (std::size_t i = 0; i != circles.x.size(); ++i)
+            f(Point{circles.x[i], circles.y[i]});
+        for (std::size_t i = 0; i != triangles.x[0].size(); ++i)
+            f(centroid(triangles.x, triangles.y, static_cast<int>(i)));
+        for (std::size_t i = 0; i != smileys.x.size(); ++i)
+            f(Point{smileys.x[i], smileys.y[i]});
+    }
+
+    // Move every shape by (dx, dy)
+    void translate_all(int dx, int dy) {
+        shift(circles.x, circles.y, dx, dy);
+        for (int k = 0; k != 3; ++k)
+            shift(triangles.x[k], triangles.y[k], dx, dy);
+        shift(smileys.x, smileys.y, dx, dy);
+        for (int k = 0; k != 2; ++k)
+            shift(smileys.eye_x[k], smileys.eye_y[k], dx, dy);
+        for (int k = 0; k != 3; ++k)
+            shift(smileys.mouth_x[k], smileys.mouth_y[k], dx, dy);
+    }
+
+    // Rotate every shape about its own center, as Shape::rotate does
+    void rotate_all(int angle) {
+        const std::size_t nt = triangles.x[0].size();
+        std::vector<int> cx(nt), cy(nt);
+        for (std::size_t i = 0; i != nt; ++i) {
+            const Point c = centroid(triangles.x, triangles.y, static_cast<int>(i));
+            cx[i] = c.x;
+            cy[i] = c.y;
+        }
+        for (int k = 0; k != 3; ++k)
+            rotate_points(triangles.x[k].data(), triangles.y[k].data(), cx.data(), cy.data(), nt, angle);
+
+        // A smiley's parts turn about the face center; round eyes need nothing more
+        const std::size_t ns = smileys.x.size();
+        for (int k = 0; k != 2; ++k)
+            rotate_points(smileys.eye_x[k].data(), smileys.eye_y[k].data(),
+                          smileys.x.data(), smileys.y.data(), ns, angle);
+        for (int k = 0; k != 3; ++k)
+            rotate_points(smileys.mouth_x[k].data(), smileys.mouth_y[k].data(),
+                          smileys.x.data(), smileys.y.data(), ns, angle);
+    }
+};
+
+// 3.5 A closed hierarchy: shapes as a std::variant of value types
+// When the set of shapes is fixed, each shape can be a plain value held
+// inline (no heap allocation, no vtable pointer) and operations dispatch
+// with std::visit; the type query is a variant index, not a dynamic_cast.
+namespace closed {
+
+struct Circle {
+    Point p;   // Center
+    int r;     // Radius
+
+    Point center() const { return p; }
+    void move(Point to) { p = to; }
+    void rotate(int) {}  // Circles remain the same when rotated
+    void draw() const {
+        std::cout << "Drawing Circle at (" << p.x << "," << p.y
+                  << ") with radius " << r << std::endl;
+    }
+};
+
+struct Triangle {
+    Point p1, p2, p3;  // Three vertices
+
+    Point center() const {
+        return Point{(p1.x + p2.x + p3.x) / 3, (p1.y + p2.y + p3.y) / 3};
+    }
+    void move(Point to) {
+        const Point c = center();
+        const int dx = to.x - c.x;
+        const int dy = to.y - c.y;
+        for (Point* v : {&p1, &p2, &p3}) {
+            v->x += dx;
+            v->y += dy;
+        }
+    }
+    void rotate(int angle) {
+        const Point c = center();
+        const Rotation r{static_cast<double>(angle)};
+        for (Point* v : {&p1, &p2, &p3})
+            *v = rotate_point(*v, c, r);
+    }
+    void draw() const {
+        std::cout << "Drawing Triangle with vertices at "
+                  << "(" << p1.x << "," << p1.y << "), "
+                  << "(" << p2.x << "," << p2.y << "), "
+                  << "(" << p3.x << "," << p3.y << ")"
+                  << std::endl;
+    }
+};
+
+// A face with the layout create_shape() builds: two round eyes and a triangular mouth
+struct Smiley {
+    Circle face;
+    Circle eyes[2];
+    Triangle mouth;
+
+    explicit Smiley(Point p = {}, int r = 0)
+        : face{p, r},
+          eyes{{{p.x - 7, p.y - 7}, 5}, {{p.x + 7, p.y - 7}, 5}},
+          mouth{{p.x - 5, p.y + 5}, {p.x + 5, p.y + 5}, {p.x, p.y + 10}} {}
+
+    Point center() const { return face.center(); }
+    void move(Point to) {
+        const int dx = to.x - face.p.x;
+        const int dy = to.y - face.p.y;
+        face.move(to);
+        for (auto& e : eyes)
+            e.move(Point{e.p.x + dx, e.p.y + dy});
+        const Point m = mouth.center();
+        mouth.move(Point{m.x + dx, m.y + dy});
+    }
+    void rotate(int angle) {
+        const Rotation r{static_cast<double>(angle)};
+        for (auto& e : eyes)
+            e.move(rotate_point(e.center(), face.p, r));
+        mouth.move(rotate_point(mouth.center(), face.p, r));
+        mouth.rotate(angle);
+    }
+    void draw() const {
+        face.draw();
+        for (const auto& e : eyes)
+            e.draw();
+        mouth.draw();
+    }
+};
+
+// The alternatives are in ShapeType order, so index() is the shape's kind
+using Shape = std::variant<Circle, Triangle, Smiley>;
+static_assert(std::is_same_v<std::variant_alternative_t<static_cast<int>(ShapeType::circle), Shape>, Circle>);
+static_assert(std::is_same_v<std::variant_alternative_t<static_cast<int>(ShapeType::triangle), Shape>, Triangle>);
+static_assert(std::is_same_v<std::variant_alternative_t<static_cast<int>(ShapeType::smiley), Shape>, Smiley>);
+
+Point center(const Shape& s) { return std::visit([](const auto& x) { return x.center(); }, s); }
+void move(Shape& s, Point to) { std::visit([to](auto& x) { x.move(to); }, s); }
+void rotate(Shape& s, int angle) { std::visit([angle](auto& x) { x.rotate(angle); }, s); }
+void draw(const Shape& s) { std::visit([](const auto& x) { x.draw(); }, s); }
+
+// Type queries replacing dynamic_cast
+ShapeType kind(const Shape& s) { return static_cast<ShapeType>(s.index()); }
+
+template<typename T>
+T* as(Shape& s) { return std::get_if<T>(&s); }
+
+Shape make_shape(ShapeType type) {
+    switch (type) {
+        case ShapeType::circle:   return Circle{Point{10, 10}, 20};
+        case ShapeType::triangle: return Triangle{Point{0, 0}, Point{20, 0}, Point{10, 20}};
+        case ShapeType::smiley:   return Smiley{Point{15, 15}, 30};
+    }
+    throw std::invalid_argument("closed::make_shape");
+}
+
+void draw_all(const std::vector<Shape>& v) {
+    for (const auto& s : v)
+        draw(s);
+}
+
+void rotate_all(std::vector<Shape>& v, int angle) {
+    for (auto& s : v)
+        rotate(s, angle);
+}
+
+} // namespace closed
+
+// 3.6 A flat scene graph
+// All parts of all shapes live in one contiguous array of nodes. A composite
+// (a Smiley's face) lists its children as a range of indices into that array,
+// and every node's position is stored relative to its parent, so moving a
+// composite is a single update. Parents always precede their children, so
+// world positions come out of one linear pass over the array.
+class Scene {
+public:
+    struct Node {
+        ShapeType type;        // circle or triangle; a smiley is a circle with children
+        int parent;            // index of the parent node, or -1 for a top-level shape
+        int first_child;       // children are nodes [first_child, first_child + child_count)
+        int child_count;
+        Point offset;          // position relative to the parent (absolute for top level)
+        int r;                 // radius, for circles
+        Point v[3];            // vertices relative to the node's position, for triangles
+    };
+
+private:
+    std::vector<Node> nodes;
+
+    int add_node(Node n) {
+        const int id = static_cast<int>(nodes.size());
+        if (n.parent >= 0) {
+            Node& p = nodes[n.parent];
+            if (p.child_count == 0) p.first_child = id;
+            else if (p.first_child + p.child_count != id)
+                throw std::logic_error("Scene: children must be added right after their parent");
+            ++p.child_count;
+            const Point w = world(n.parent);
+            n.offset = Point{n.offset.x - w.x, n.offset.y - w.y};
+        }
+        nodes.push_back(n);
+        return id;
+    }
+
+public:
+    // Positions are given in world coordinates
+    int add_circle(Point p, int r, int parent = -1) {
+        return add_node(Node{ShapeType::circle, parent, 0, 0, p, r, {}});
+    }
+
+    int add_triangle(Point a, Point b, Point c, int parent = -1) {
+        const Point m{(a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3};
+        return add_node(Node{ShapeType::triangle, parent, 0, 0, m, 0,
+                             {{a.x - m.x, a.y - m.y}, {b.x - m.x, b.y - m.y}, {c.x - m.x, c.y - m.y}}});
+    }
+
+    // A face and its parts, laid out as create_shape() does
+    int add_smiley(Point p, int r) {
+        const int face = add_circle(p, r);
+        add_circle(Point{p.x - 7, p.y - 7}, 5, face);
+        add_circle(Point{p.x + 7, p.y - 7}, 5, face);
+        add_triangle(Point{p.x - 5, p.y + 5}, Point{p.x + 5, p.y + 5}, Point{p.x, p.y + 10}, face);
+        return face;
+    }
+
+    const Node& operator[](int id) const { return nodes[id]; }
+    int size() const { return static_cast<int>(nodes.size()); }
+    void reserve(int n) { nodes.reserve(n); }
+
+    Point world(int id) const {
+        Point w{0, 0};
+        for (; id >= 0; id = nodes[id].parent) {
+            w.x += nodes[id].offset.x;
+            w.y += nodes[id].offset.y;
+        }
+        return w;
+    }
+
+    Point center(int id) const { return world(id); }
+
+    // The children follow along through their relative offsets
+    void move(int id, Point to) {
+        Node& n = nodes[id];
+        const Point w = world(id);
+        n.offset.x += to.x - w.x;
+        n.offset.y += to.y - w.y;
+    }
+
+    // World position of every node, in one pass
+    std::vector<Point> world_positions() const {
+        std::vector<Point> w(nodes.size());
+        for (std::size_t i = 0; i != nodes.size(); ++i) {
+            const Node& n = nodes[i];
+            const Point base = n.parent < 0 ? Point{0, 0} : w[n.parent];
+            w[i] = Point{base.x + n.offset.x, base.y + n.offset.y};
+        }
+        return w;
+    }
+
+    void draw() const {
+        const std::vector<Point> w = world_positions();
+        for (std::size_t i = 0; i != nodes.size(); ++i) {
+            const Node& n = nodes[i];
+            const Point p = w[i];
+            if (n.type == ShapeType::circle) {
+                std::cout << "Drawing Circle at (" << p.x << "," << p.y
+                          << ") with radius " << n.r << std::endl;
+            }
+            else {
+                std::cout << "Drawing Triangle with vertices at ";
+                for (int k = 0; k != 3; ++k)
+                    std::cout << "(" << p.x + n.v[k].x << "," << p.y + n.v[k].y << ")" << (k != 2 ? ", " : "");
+                std::cout << std::endl;
+            }
+        }
+    }
+};
+
+// 3.7 Render sinks: Text_sink, Command_sink and Framebuffer_sink are in render_sinks.h
+
+// ==========================================
+// PART 4: BENCHMARKS
+// ==========================================
+
+// Run f once and return the elapsed wall-clock time in milliseconds
+template<typename F>
+double time_ms(F f) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+// 4.1 Append throughput of Vector::push_back against std::vector<double>
+void bench_push_back(int max_n) {
+    std::cout << "push_back throughput (million elements/s):\n";
+    for (long long n = 1000; n <= max_n; n *= 10) {
+        double check = 0;  // Consume the results so the loops are not optimized away
+        double t_vec = time_ms([&] {
+            Vector v;
+            for (int i = 0; i != n; ++i) v.push_back(i);
+            check += v[v.size() - 1];
+        });
+        double t_std = time_ms([&] {
+            std::vector<double> v;
+            for (int i = 0; i != n; ++i) v.push_back(i);
+            check += v.back();
+        });
+        std::cout << "  n = " << n
+                  << "  Vector: " << n / t_vec / 1000
+                  << "  std::vector: " << n / t_std / 1000
+                  << "  (check " << check << ")\n";
+    }
+}
+
+// 4.2 Element access: checked at() vs operator[] vs iterators, against memcpy
+void bench_access(int n) {
+    Vector v(n);
+    Vector w(n);
+    std::iota(v.begin(), v.end(), 0.0);
+    const double gb = n * sizeof(double) / 1e9;
+    double s1 = 0, s2 = 0, s3 = 0;
+
+    std::cout << "access over " << n << " doubles (GB/s):\n";
+    double t_at = time_ms([&] { for (int i = 0; i != n; ++i) s1 += v.at(i); });
+    double t_sub = time_ms([&] { for (int i = 0; i != n; ++i) s2 += v[i]; });
+    double t_it = time_ms([&] { s3 = std::accumulate(v.begin(), v.end(), 0.0); });
+    std::cout << "  sum  at(): " << gb / t_at * 1000
+              << "  operator[]: " << gb / t_sub * 1000
+              << "  iterators: " << gb / t_it * 1000
+              << "  (check " << s1 + s2 + s3 << ")\n";
+
+    double t_cat = time_ms([&] { for (int i = 0; i != n; ++i) w.at(i) = v.at(i); });
+    double t_cit = time_ms([&] { std::copy(v.begin(), v.end(), w.begin()); });
+    double t_mem = time_ms([&] { std::memcpy(w.data(), v.data(), n * sizeof(double)); });
+    std::cout << "  copy at(): " << gb / t_cat * 1000
+              << "  std::copy: " << gb / t_cit * 1000
+              << "  memcpy: " << gb / t_mem * 1000
+              << "  (check " << w[n - 1] << ")\n";
+}
+
+// 4.3 Summing a List_container by position and with a cursor
+void bench_list_container(int n) {
+    List_container lc;
+    for (int i = 0; i != n; ++i) lc.push_back(i);
+    double s1 = 0, s2 = 0;
+
+    std::cout << "List_container scan over " << n << " elements (ms):\n";
+    double t_sub = time_ms([&] {
+        const int sz = lc.size();
+        for (int i = 0; i != sz; ++i) s1 += lc[i];
+    });
+    double t_cur = time_ms([&] {
+        for (auto p = lc.cursor(); !p->done(); p->next()) s2 += p->get();
+    });
+    std::cout << "  operator[]: " << t_sub << "  cursor: " << t_cur
+              << "  (check " << s1 + s2 << ")\n";
+}
+
+// 4.4 Per-element virtual access vs chunked traversal of a Container
+void bench_batch(int n) {
+    Vector_container vc(n);
+    List_container lc;
+    for (int i = 0; i != n; ++i) {
+        vc[i] = i;
+        lc.push_back(i);
+    }
+    std::vector<double> out(n);
+
+    std::cout << "Container traversal over " << n << " doubles (ms):\n";
+    for (Container* c : {static_cast<Container*>(&vc), static_cast<Container*>(&lc)}) {
+        double s1 = 0, s2 = 0;
+        double t_elem = time_ms([&] {
+            const int sz = c->size();
+            for (int i = 0; i != sz; ++i) s1 += (*c)[i];
+        });
+        double t_span = time_ms([&] { s2 = sum(*c); });
+        double t_copy = time_ms([&] { c->copy_to(out); });
+        std::cout << (c == &vc ? "  Vector_container" : "  List_container  ")
+                  << "  operator[]: " << t_elem << "  for_each_span: " << t_span
+                  << "  copy_to: " << t_copy
+                  << "  (check " << s1 + s2 + out[n - 1] << ")\n";
+    }
+}
+
+// 4.5 center/move over mixed shapes: pointer vector vs ShapeStore
+void bench_shape_store(int n) {
+    std::vector<std::unique_ptr<Shape>> shapes;
+    ShapeStore store;
+    std::vector<Shape_handle> handles;
+    for (int i = 0; i != n; ++i) {
+        auto type = static_cast<ShapeType>(i % 3);
+        shapes.push_back(create_shape(type));
+        handles.push_back(store.add(type));
+    }
+
+    std::cout << "center/move over " << n << " mixed shapes (ms):\n";
+    long long c1 = 0, c2 = 0, c3 = 0;
+    double t_ptr = time_ms([&] {
+        for (auto& p : shapes) c1 += p->center().x;
+    });
+    double t_hnd = time_ms([&] {
+        for (auto h : handles) c2 += store.center(h).x;
+    });
+    double t_all = time_ms([&] {
+        store.for_each_center([&](Point p) { c3 += p.x; });
+    });
+    std::cout << "  center  unique_ptr<Shape>: " << t_ptr << "  handles: " << t_hnd
+              << "  type by type: " << t_all << "  (check " << c1 + c2 + c3 << ")\n";
+
+    t_ptr = time_ms([&] {
+        for (auto& p : shapes) {
+            Point c = p->center();
+            p->move(Point{c.x + 1, c.y + 1});
+        }
+    });
+    t_hnd = time_ms([&] {
+        for (auto h : handles) {
+            Point c = store.center(h);
+            store.move(h, Point{c.x + 1, c.y + 1});
+        }
+    });
+    t_all = time_ms([&] { store.translate_all(1, 1); });
+    std::cout << "  move    unique_ptr<Shape>: " << t_ptr << "  handles: " << t_hnd
+              << "  translate_all: " << t_all
+              << "  (check " << shapes.back()->center().x + store.center(handles.back()).x << ")\n";
+}
+
+// 4.6 Bulk point kernels: each implementation checked against scalar and timed
+void bench_point_kernels(int n) {
+    std::vector<float> x0(n), y0(n);
+    std::vector<int> xi0(n), yi0(n), cx(n), cy(n);
+    for (int i = 0; i != n; ++i) {
+        x0[i] = static_cast<float>(i % 1000);
+        y0[i] = static_cast<float>(i % 997);
+        xi0[i] = i % 1000;
+        yi0[i] = i % 997;
+        cx[i] = i % 7;
+        cy[i] = i % 11;
+    }
+
+    // Reference results from the scalar kernels
+    std::vector<float> xr = x0, yr = y0;
+    std::vector<int> xir = xi0, yir = yi0;
+    scalar_kernels.rotatef(xr.data(), yr.data(), n, 500, 500, Rotation{30.0});
+    scalar_kernels.rotate(xir.data(), yir.data(), cx.data(), cy.data(), n, Rotation{30.0});
+
+    std::cout << "point kernels over " << n << " points (million points/s), best = "
+              << point_kernels().name << ":\n";
+    for (const Point_kernels* k : supported_point_kernels()) {
+        std::vector<float> x = x0, y = y0;
+        std::vector<int> xi = xi0, yi = yi0;
+        const double t_rf = time_ms([&] { k->rotatef(x.data(), y.data(), n, 500, 500, Rotation{30.0}); });
+        const double t_ri = time_ms([&] { k->rotate(xi.data(), yi.data(), cx.data(), cy.data(), n, Rotation{30.0}); });
+
+        float max_err = 0;
+        int max_diff = 0;
+        for (int i = 0; i != n; ++i) {
+            max_err = std::max({max_err, std::abs(x[i] - xr[i]), std::abs(y[i] - yr[i])});
+            max_diff = std::max({max_diff, std::abs(xi[i] - xir[i]), std::abs(yi[i] - yir[i])});
+        }
+
+        const double t_tf = time_ms([&] { k->translatef(x.data(), y.data(), n, 1, 1); });
+        const double t_ti = time_ms([&] { k->translate(xi.data(), yi.data(), n, 1, 1); });
+        std::cout << "  " << k->name
+                  << "  float rotate: " << n / t_rf / 1000 << "  translate: " << n / t_tf / 1000
+                  << "  int rotate: " << n / t_ri / 1000 << "  translate: " << n / t_ti / 1000
+                  << "  (max error vs scalar: " << max_err << ", " << max_diff << ")\n";
+    }
+}
+
+// 4.7 Virtual dispatch and dynamic_cast vs std::variant visitation
+void bench_variant(int n) {
+    std::vector<std::unique_ptr<Shape>> shapes;
+    std::vector<closed::Shape> values;
+    for (int i = 0; i != n; ++i) {
+        auto type = static_cast<ShapeType>(i % 3);
+        shapes.push_back(create_shape(type));
+        values.push_back(closed::make_shape(type));
+    }
+
+    std::cout << "dispatch over " << n << " shapes (ms):\n";
+    long long c1 = 0, c2 = 0;
+    double t_virt = time_ms([&] {
+        for (auto& p : shapes) c1 += p->center().x;
+    });
+    double t_visit = time_ms([&] {
+        for (auto& s : values) c2 += closed::center(s).x;
+    });
+    std::cout << "  center  virtual: " << t_virt << "  std::visit: " << t_visit
+              << "  (check " << c1 + c2 << ")\n";
+
+    t_virt = time_ms([&] {
+        for (auto& p : shapes) {
+            Point c = p->center();
+            p->move(Point{c.x + 1, c.y + 1});
+        }
+    });
+    t_visit = time_ms([&] {
+        for (auto& s : values) {
+            Point c = closed::center(s);
+            closed::move(s, Point{c.x + 1, c.y + 1});
+        }
+    });
+    std::cout << "  move    virtual: " << t_virt << "  std::visit: " << t_visit << '\n';
+
+    int k1[3] = {}, k2[3] = {};
+    double t_cast = time_ms([&] {
+        for (auto& p : shapes) {
+            if (dynamic_cast<Smiley*>(p.get())) ++k1[2];
+            else if (dynamic_cast<Circle*>(p.get())) ++k1[0];
+            else if (dynamic_cast<Triangle*>(p.get())) ++k1[1];
+        }
+    });
+    double t_kind = time_ms([&] {
+        for (auto& s : values) ++k2[static_cast<int>(closed::kind(s))];
+    });
+    std::cout << "  classify  dynamic_cast: " << t_cast << "  index(): " << t_kind
+              << "  (check " << k1[0] + k1[1] + k1[2] << " " << k2[0] + k2[1] + k2[2] << ")\n";
+}
+
+// 4.8 Creating and moving smileys: Smiley objects vs the flat Scene
+void bench_scene(int n) {
+    std::cout << "create/move " << n << " smileys (ms):\n";
+    std::vector<std::unique_ptr<Shape>> shapes;
+    Scene scene;
+    std::vector<int> faces;
+
+    double t_obj = time_ms([&] {
+        for (int i = 0; i != n; ++i) shapes.push_back(create_shape(ShapeType::smiley));
+    });
+    double t_scene = time_ms([&] {
+        scene.reserve(4 * n);  // A face and three parts each
+        for (int i = 0; i != n; ++i) faces.push_back(scene.add_smiley(Point{15, 15}, 30));
+    });
+    std::cout << "  create  Smiley: " << t_obj << "  Scene: " << t_scene << '\n';
+
+    t_obj = time_ms([&] {
+        for (auto& p : shapes) {
+            Point c = p->center();
+            p->move(Point{c.x + 1, c.y + 1});
+        }
+    });
+    t_scene = time_ms([&] {
+        for (int f : faces) {
+            Point c = scene.center(f);
+            scene.move(f, Point{c.x + 1, c.y + 1});
+        }
+    });
+    long long check = 0;
+    double t_world = time_ms([&] {
+        for (Point p : scene.world_positions()) check += p.x;
+    });
+    std::cout << "  move    Smiley: " << t_obj << "  Scene: " << t_scene
+              << "  (world positions of all parts: " << t_world << ", check " << check << ")\n";
+}
+
+// 4.9 Frames per second drawing shapes: std::cout with std::endl vs the sinks.
+// Stream output goes to /dev/null, so this measures the drawing and the writes.
+void bench_render(int n) {
+    std::vector<std::unique_ptr<Shape>> shapes;
+    for (int i = 0; i != n; ++i)
+        shapes.push_back(create_shape(static_cast<ShapeType>(i % 3)));
+
+    std::ofstream null_out("/dev/null", std::ios::binary);
+    if (!null_out) {
+        std::cout << "render benchmark skipped: cannot open /dev/null\n";
+        return;
+    }
+
+    constexpr int frames = 3;
+    auto fps = [&](auto frame) { return frames / time_ms([&] { for (int f = 0; f != frames; ++f) frame(); }) * 1000; };
+
+    std::streambuf* saved = std::cout.rdbuf(null_out.rdbuf());
+    const double fps_cout = fps([&] { draw_all(shapes); });
+    std::cout.rdbuf(saved);
+
+    Text_sink text{null_out};
+    Command_sink commands{null_out};
+    Framebuffer_sink framebuffer{1024, 1024};
+    const double fps_text = fps([&] { draw_all(shapes, text); });
+    const double fps_cmd = fps([&] { draw_all(shapes, commands); });
+    const double fps_fb = fps([&] { framebuffer.clear(); draw_all(shapes, framebuffer); });
+
+    std::cout << "frames/s drawing " << n << " shapes:\n"
+              << "  std::cout: " << fps_cout << "  Text_sink: " << fps_text
+              << "  Command_sink: " << fps_cmd << "  Framebuffer_sink: " << fps_fb << '\n';
+}
+
+// 4.10 Complex arithmetic: ComplexArray against std::vector<std::complex<double>>
+void bench_complex(int n) {
+    ComplexArray a(n), b(n), c(n);
+    std::vector<std::complex<double>> sa(n), sb(n), sc(n);
+    for (int i = 0; i != n; ++i) {
+        a.set(i, Complex{i * 0.5, 1.0 - i * 0.25});
+        b.set(i, Complex{1.0 / (i + 1), i * 0.125});
+        sa[i] = {i * 0.5, 1.0 - i * 0.25};
+        sb[i] = {1.0 / (i + 1), i * 0.125};
+    }
+
+    std::cout << "complex arithmetic over " << n << " elements (ms):\n";
+    double t_soa = time_ms([&] { mul(a, b, c); });
+    double t_std = time_ms([&] { for (int i = 0; i != n; ++i) sc[i] = sa[i] * sb[i]; });
+    std::cout << "  multiply  ComplexArray: " << t_soa << "  std::complex: " << t_std
+              << "  (check " << c[n - 1].real() - sc[n - 1].real() << ")\n";
+
+    t_soa = time_ms([&] { mul_add(a, b, c); });
+    t_std = time_ms([&] { for (int i = 0; i != n; ++i) sc[i] += sa[i] * sb[i]; });
+    std::cout << "  mul_add   ComplexArray: " << t_soa << "  std::complex: " << t_std
+              << "  (check " << c[n - 1].real() - sc[n - 1].real() << ")\n";
+
+    Complex d;
+    std::complex<double> sd;
+    t_soa = time_ms([&] { d = dot(a, b); });
+    t_std = time_ms([&] { for (int i = 0; i != n; ++i) sd += sa[i] * sb[i]; });
+    std::cout << "  dot       ComplexArray: " << t_soa << "  std::complex: " << t_std
+              << "  (relative difference " << abs(d - Complex{sd.real(), sd.imag()}) / abs(d) << ")\n";
+}
+
+// 4.11 FFT: accuracy against the naive DFT, then throughput
+void bench_fft(int max_n) {
+    auto signal = [](int n) {
+        std::vector<Complex> x(n);
+        for (int i = 0; i != n; ++i)
+            x[i] = Complex{std::sin(0.1 * i) + 0.01 * (i % 7), std::cos(0.3 * i)};
+        return x;
+    };
+    auto max_error = [](std::span<const Complex> a, std::span<const Complex> b) {
+        double e = 0, m = 0;
+        for (std::size_t i = 0; i != a.size(); ++i) {
+            e = std::max(e, abs(a[i] - b[i]));
+            m = std::max(m, abs(b[i]));
+        }
+        return e / m;
+    };
+
+    std::cout << "FFT relative error vs naive DFT:\n ";
+    for (int n : {1, 2, 8, 12, 60, 64, 97, 128, 360, 1000, 1024, 4096}) {
+        auto x = signal(n);
+        const auto ref = naive_dft<Complex>(x);
+        fft<Complex>(x);
+        std::cout << " n=" << n << ": " << max_error(x, ref);
+    }
+    std::cout << '\n';
+
+    {   // Large sizes: blocked and threaded against unblocked single-threaded, and a round trip
+        const int n = 1 << 18;
+        const auto x0 = signal(n);
+        auto a = x0, b = x0;
+        fft<Complex>(a, FFT_options{n, n + 1, 1});
+        fft<Complex>(b, FFT_options{1 << 10, 1 << 12, 4});
+        const double e_blocked = max_error(b, a);
+        ifft<Complex>(b);
+        std::cout << "  n=" << n << ": blocked/threaded vs plain " << e_blocked
+                  << ", ifft(fft(x)) vs x " << max_error(b, x0) << '\n';
+    }
+
+    std::cout << "FFT throughput (ms, GFLOP/s as 5 n log2 n):\n";
+    for (int log2n = 8; log2n <= 24 && (1 << log2n) <= std::max(max_n, 256); ++log2n) {
+        const int n = 1 << log2n;
+        auto x = signal(n);
+        fft<Complex>(x);  // Build the plan outside the timing
+        const int reps = std::max(1, (1 << 22) / n);
+        const double t = time_ms([&] { for (int r = 0; r != reps; ++r) fft<Complex>(x); }) / reps;
+        std::cout << "  2^" << log2n << ": " << t << "  " << 5.0 * n * log2n / t / 1e6 << '\n';
+    }
+}
+
+// 4.12 Reading numbers from a file: read() vs read_fast() vs read_file()
+void bench_read(int n) {
+    const auto path = std::filesystem::temp_directory_path() / "ch05_class_bench_numbers.txt";
+    {
+        std::ofstream out(path);
+        for (int i = 0; i != n; ++i)
+            out << i * 0.001 - 17.25 << (i % 10 == 9 ? '\n' : ' ');
+    }
+    const double mb = std::filesystem::file_size(path) / 1e6;
+    const int hw = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::cout << "reading " << n << " numbers (" << mb << " MB), MB/s:\n";
+    Vector v1, v2, v3, v4;
+    double t1 = time_ms([&] { std::ifstream in(path); v1 = read(in); });
+    double t2 = time_ms([&] { std::ifstream in(path, std::ios::binary); v2 = read_fast<Vector>(in); });
+    double t3 = time_ms([&] { v3 = read_file<Vector>(path.string()); });
+    double t4 = time_ms([&] { v4 = read_file<Vector>(path.string(), hw); });
+    const bool same = v1.size() == v2.size() && v1.size() == v3.size() && v1.size() == v4.size()
+        && std::equal(v1.begin(), v1.end(), v2.begin()) && std::equal(v1.begin(), v1.end(), v3.begin())
+        && std::equal(v1.begin(), v1.end(), v4.begin());
+    std::cout << "  read: " << mb / t1 * 1000 << "  read_fast: " << mb / t2 * 1000
+              << "  read_file: " << mb / t3 * 1000 << "  read_file(" << hw << " threads): " << mb / t4 * 1000
+              << "  (" << (same ? "same values" : "VALUES DIFFER") << ")\n";
+    std::filesystem::remove(path);
+}
+
+// 4.13 Startup: parsing text with read_file() vs mapping a binary Vector file
+void bench_binary_file(int n) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto txt = (dir / "ch05_class_bench_vector.txt").string();
+    const auto bin = (dir / "ch05_class_bench_vector.bin").string();
+    Vector v(n);
+    for (int i = 0; i != n; ++i) v[i] = i * 0.5;
+    {
+        std::ofstream out(txt);
+        for (double d : v) out << d << '\n';
+    }
+
+    double t_save = time_ms([&] { save(v, bin); });
+    double t_append = time_ms([&] {
+        Vector_appender<double> app{bin};
+        for (int i = 0; i != n; ++i) app.push_back(-i);
+    });
+
+    Vector parsed;
+    double sum_map = 0;
+    bool ok = false;
+    std::size_t mapped_size = 0;
+    double t_text = time_ms([&] { parsed = read_file<Vector>(txt); });
+    double t_map = time_ms([&] {
+        Mapped_vector<double> m{bin};
+        mapped_size = m.size();
+        sum_map = m[0] + m[mapped_size - 1];
+    });
+    double t_verify = time_ms([&] { ok = Mapped_vector<double>{bin}.verify(); });
+    std::cout << n << " doubles to ready (ms):  read_file(text): " << t_text
+              << "  Mapped_vector: " << t_map << "  (+ verify: " << t_verify << ")\n"
+              << "  save: " << t_save << "  append " << n << ": " << t_append
+              << "  (mapped " << mapped_size << " elements, checksum " << (ok ? "ok" : "BAD")
+              << ", check " << sum_map + parsed.size() << ")\n";
+    std::filesystem::remove(txt);
+    std::filesystem::remove(bin);
+}
+
 // Main function to demonstrate concepts
-int main() {
+// Usage: ch05_class [max_benchmark_size]  (default 1000000, e.g. 100000000 for 100M)
+// Usage: ch05_class [--bench [max_n]]  (the benchmarks run only with --bench; max_n defaults to 1000000)
+int main(int argc, char* argv[]) {
+    const bool bench = argc > 1 && std::string_view{argv[1]} == "--bench";
+    const int bench_max = bench && argc > 2 ? std::atoi(argv[2]) : 1'000'000;
+
     std::cout << "==== CONCRETE TYPES DEMONSTRATION ====\n";
     
     // Complex numbers
     Complex a{1, 2};
     Complex b{3};
     Complex c = a + b;
-    std::cout << "Complex number: " << c.real() << " + " << c.imag() << "i\n\n";
+    std::cout << "Complex number: " << c.real() << " + " << c.imag() << "i\n";
+    Complex q = a * b / c;
+    std::cout << "a * b / c = " << q.real() << " + " << q.imag() << "i, |c| = " << abs(c)
+              << ", exp(i*pi) = " << exp(Complex{0, std::numbers::pi}).real() << "\n\n";
     
     // Vector
     Vector v1 = {1, 2, 3, 4, 5};
     for (int i = 0; i < v1.size(); ++i)
         std::cout << "v1[" << i << "] = " << v1[i] << '\n';
+    
+    // Growth: capacity doubles when full, so appends are amortized O(1)
+    Vector v2;
+    v2.reserve(4);
+    for (int i = 0; i != 10; ++i)
+        v2.emplace_back(i);
+    std::cout << "v2.size() = " << v2.size() << ", v2.capacity() = " << v2.capacity() << '\n';
+    v2.shrink_to_fit();
+    std::cout << "after shrink_to_fit, v2.capacity() = " << v2.capacity() << '\n';
     std::cout << "\n";
     
     std::cout << "==== ABSTRACT TYPES DEMONSTRATION ====\n";
@@ -427,6 +1667,14 @@ int main() {
     
     std::cout << "\nUsing List_container:\n";
     use(lc);
+    std::cout << "sum(vc) = " << sum(vc) << ", sum(lc) = " << sum(lc) << '\n';
+    
+    // References into a List_container survive insertion and erasure elsewhere
+    double& fifth = lc[4];
+    lc.insert(0, 0);
+    lc.erase(9);
+    std::cout << "after insert(0, 0) and erase(9): lc[5] = " << lc[5]
+              << ", fifth = " << fifth << ", size = " << lc.size() << '\n';
     std::cout << "\n";
     
     std::cout << "==== CLASS HIERARCHIES DEMONSTRATION ====\n";
@@ -443,6 +1691,11 @@ int main() {
     std::cout << "Drawing all shapes:\n";
     draw_all(shapes);
     
+    // The same frame through a sink: built in memory, written once
+    std::cout << "\nDrawing all shapes through a Text_sink:\n";
+    Text_sink text{std::cout};
+    draw_all(shapes, text);
+    
     // Rotate all shapes
     std::cout << "\nRotating all shapes by 45 degrees:\n";
     rotate_all(shapes, 45);
@@ -462,5 +1715,61 @@ int main() {
         }
     }
     
+    // The same shapes in per-type pools, reached through handles
+    std::cout << "\nShapeStore with one shape of each type:\n";
+    ShapeStore store;
+    std::vector<Shape_handle> handles;
+    for (auto type : {ShapeType::circle, ShapeType::triangle, ShapeType::smiley})
+        handles.push_back(store.add(type));
+    store.move(handles[2], Point{50, 50});
+    store.rotate_all(90);
+    store.for_each_center([](Point p) {
+        std::cout << "center at (" << p.x << "," << p.y << ")\n";
+    });
+    
+    // The same shapes again as values in a std::variant
+    std::cout << "\nClosed hierarchy with std::variant:\n";
+    std::vector<closed::Shape> values;
+    for (auto type : {ShapeType::circle, ShapeType::triangle, ShapeType::smiley})
+        values.push_back(closed::make_shape(type));
+    closed::rotate_all(values, 90);
+    closed::draw_all(values);
+    for (auto& v : values) {
+        if (auto* s = closed::as<closed::Smiley>(v))
+            std::cout << "Found a Smiley with a face of radius " << s->face.r << ".\n";
+        else if (closed::kind(v) == ShapeType::circle)
+            std::cout << "Found a Circle.\n";
+        else if (closed::kind(v) == ShapeType::triangle)
+            std::cout << "Found a Triangle.\n";
+    }
+    
+    // A smiley in the flat scene graph: moving the face carries its parts
+    std::cout << "\nSmiley in a flat scene graph, moved to (50,50):\n";
+    Scene scene;
+    int face = scene.add_smiley(Point{15, 15}, 30);
+    scene.move(face, Point{50, 50});
+    scene.draw();
+    
+    if (bench) {
+        std::cout << "\n==== BENCHMARKS ====\n";
+        bench_push_back(bench_max);
+        bench_access(bench_max);
+        bench_list_container(bench_max);
+        bench_batch(bench_max);
+        bench_shape_store(bench_max);
+        bench_point_kernels(bench_max);
+        bench_variant(bench_max);
+        bench_scene(bench_max / 10);
+        bench_render(bench_max / 10);
+        bench_complex(bench_max);
+        bench_fft(bench_max);
+        bench_read(bench_max);
+        bench_binary_file(bench_max);
+    }
+
+    // Every Vector created above, including any benchmarks' (and the copies among them)
+    std::cout << "\n==== LIFECYCLE ====\n";
+    lifecycle_report(std::cout);
+    
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+// fft.h
+// Fast Fourier transform over any complex number type Z that has Z{re, im},
+// real(), imag(), +, -, * and +=: the Complex of class.cpp, or std::complex<double>.
+//
+// fft(x) replaces x by its discrete Fourier transform
+//     X[k] = sum over j of x[j] * exp(-2*pi*i*j*k/n)
+// and ifft(x) undoes it (including the 1/n scaling). Any n >= 1 works:
+//   - powers of two use an in-place radix-4 algorithm (plus one radix-2
+//     stage when log2(n) is odd) after a bit-reversal permutation;
+//   - other sizes use mixed-radix decimation in time over the prime
+//     factors of n, through a scratch copy.
+// Twiddle factors are computed once per size and cached. For powers of two
+// the early stages run block by block so each block stays in cache, and
+// large transforms are split across threads.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel_for.h"
+
+struct FFT_options {
+    int block = 1 << 13;                // Elements per cache block (a power of two)
+    int parallel_threshold = 1 << 18;   // Use threads from this size on
+    int threads = 0;                    // 0: std::thread::hardware_concurrency()
+};
+
+// exp(-2*pi*i*k/n)
+template<typename Z>
+Z fft_twiddle(long long k, int n) {
+    const double theta = -2 * std::numbers::pi * static_cast<double>(k) / n;
+    return Z{std::cos(theta), std::sin(theta)};
+}
+
+template<typename Z>
+class FFT_plan {
+public:
+    struct Stage {
+        int radix;  // 2 or 4
+        int len;    // Size of the groups the stage produces
+    };
+
+    int n;
+    bool pow2;
+    std::vector<Z> tw;          // exp(-2*pi*i*k/n): n/2 entries for powers of two, n otherwise
+    std::vector<Stage> stages;  // Powers of two
+    std::vector<int> factors;   // Other sizes: radices, largest first
+
+    explicit FFT_plan(int size) : n{size}, pow2{size > 0 && (size & (size - 1)) == 0} {
+        const int ntw = pow2 ? n / 2 : n;
+        tw.reserve(ntw);
+        for (int k = 0; k != ntw; ++k)
+            tw.push_back(fft_twiddle<Z>(k, n));
+
+        if (pow2) {
+            int len = 1;
+            int log2n = 0;
+            while ((1 << log2n) < n) ++log2n;
+            if (log2n % 2) {
+                stages.push_back({2, 2});
+                len = 2;
+            }
+            for (len *= 4; len <= n; len *= 4)
+                stages.push_back({4, len});
+        }
+        else {
+            int m = n;
+            for (int p : {5, 3, 2})
+                for (; m % p == 0; m /= p) factors.push_back(p);
+            for (int p = 7; p * p <= m; p += 2)
+                for (; m % p == 0; m /= p) factors.push_back(p);
+            if (m > 1) factors.push_back(m);
+            std::sort(factors.begin(), factors.end(), std::greater<>{});
+        }
+    }
+};
+
+// The plan for size n, built on first use and shared afterwards
+template<typename Z>
+const FFT_plan<Z>& fft_plan(int n) {
+    static std::mutex m;
+    static std::map<int, std::unique_ptr<FFT_plan<Z>>> plans;
+    std::lock_guard<std::mutex> lock{m};
+    auto& p = plans[n];
+    if (!p) p = std::make_unique<FFT_plan<Z>>(n);
+    return *p;
+}
+
+// One stage over the groups in [first, last), butterflies j in [j0, j1) of each group
+template<typename Z>
+void fft_stage(const FFT_plan<Z>& plan, Z* x, typename FFT_plan<Z>::Stage st, int first, int last, int j0, int j1) {
+    const Z* tw = plan.tw.data();
+    const int n = plan.n;
+    if (st.radix == 2) {
+        const int half = st.len / 2;
+        const int step = n / st.len;
+        for (int i = first; i < last; i += st.len)
+            for (int j = j0; j != j1; ++j) {
+                const Z u = x[i + j];
+                const Z v = x[i + j + half] * tw[j * step];
+                x[i + j] = u + v;
+                x[i + j + half] = u - v;
+            }
+        return;
+    }
+    // Two radix-2 stages fused: groups of m -> 2m -> 4m
+    const int m = st.len / 4;
+    const int step_a = n / (2 * m);
+    const int step_b = n / st.len;
+    for (int i = first; i < last; i += st.len)
+        for (int j = j0; j != j1; ++j) {
+            const Z wa = tw[j * step_a];
+            const Z wb = tw[j * step_b];
+            const Z a1 = x[i + j + m] * wa;
+            const Z a3 = x[i + j + 3 * m] * wa;
+            const Z b0 = x[i + j] + a1;
+            const Z b1 = x[i + j] - a1;
+            const Z b2 = x[i + j + 2 * m] + a3;
+            const Z b3 = x[i + j + 2 * m] - a3;
+            const Z t = wb * b2;
+            const Z u0 = wb * b3;
+            const Z u{u0.imag(), -u0.real()};  // u0 * -i: the twiddle of the odd quarter
+            x[i + j] = b0 + t;
+            x[i + j + 2 * m] = b0 - t;
+            x[i + j + m] = b1 + u;
+            x[i + j + 3 * m] = b1 - u;
+        }
+}
+
+template<typename Z>
+void fft_pow2(const FFT_plan<Z>& plan, Z* x, const FFT_options& opt) {
+    const int n = plan.n;
+    for (int i = 1, j = 0; i < n; ++i) {  // Bit-reversal permutation
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(x[i], x[j]);
+    }
+
+    const int hw = opt.threads > 0 ? opt.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const int threads = n >= opt.parallel_threshold ? hw : 1;
+    const int block = std::min(n, opt.block);
+
+    // Stages whose groups fit in a block: finish each block before the next
+    std::size_t s = 0;
+    while (s != plan.stages.size() && plan.stages[s].len <= block) ++s;
+    parallel_for(n / block, threads, [&](int b0, int b1) {
+        for (int b = b0; b != b1; ++b)
+            for (std::size_t k = 0; k != s; ++k) {
+                const auto st = plan.stages[k];
+                fft_stage(plan, x, st, b * block, (b + 1) * block, 0, st.len / st.radix);
+            }
+    });
+
+    // The remaining stages span blocks; split each group's butterflies across threads
+    for (; s != plan.stages.size(); ++s) {
+        const auto st = plan.stages[s];
+        parallel_for(st.len / st.radix, threads, [&](int j0, int j1) {
+            fft_stage(plan, x, st, 0, n, j0, j1);
+        });
+    }
+}
+
+// Mixed radix: out[0, n/stride) = DFT of in[0], in[stride], in[2*stride], ...
+template<typename Z>
+void fft_mixed(const FFT_plan<Z>& plan, Z* out, const Z* in, int stride, const int* factor) {
+    const int p = *factor;
+    const int m = plan.n / stride / p;
+    if (m == 1) {
+        for (int q = 0; q != p; ++q) out[q] = in[q * stride];
+    }
+    else {
+        for (int q = 0; q != p; ++q)
+            fft_mixed(plan, out + q * m, in + q * stride, stride * p, factor + 1);
+    }
+
+    // Radix-p butterflies combining p transforms of size m
+    const Z* tw = plan.tw.data();
+    const int n = plan.n;
+    std::vector<Z> t(p);
+    for (int u = 0; u != m; ++u) {
+        for (int q = 0; q != p; ++q) t[q] = out[u + q * m];
+        for (int q1 = 0; q1 != p; ++q1) {
+            const int k = u + q1 * m;
+            Z sum = t[0];
+            long long idx = 0;
+            for (int q = 1; q != p; ++q) {
+                idx = (idx + static_cast<long long>(stride) * k) % n;
+                sum += t[q] * tw[idx];
+            }
+            out[k] = sum;
+        }
+    }
+}
+
+template<typename Z>
+void fft(std::span<Z> x, const FFT_options& opt = {}) {
+    const int n = static_cast<int>(x.size());
+    if (n <= 1) return;
+    const FFT_plan<Z>& plan = fft_plan<Z>(n);
+    if (plan.pow2) {
+        fft_pow2(plan, x.data(), opt);
+    }
+    else {
+        const std::vector<Z> in(x.begin(), x.end());
+        fft_mixed(plan, x.data(), in.data(), 1, plan.factors.data());
+    }
+}
+
+// The inverse via conj(fft(conj(x))) / n
+template<typename Z>
+void ifft(std::span<Z> x, const FFT_options& opt = {}) {
+    for (auto& z : x) z = Z{z.real(), -z.imag()};
+    fft(x, opt);
+    const double scale = 1.0 / static_cast<double>(x.size());
+    for (auto& z : x) z = Z{z.real() * scale, -z.imag() * scale};
+}
+
+// The O(n^2) definition, for checking fft()
+template<typename Z>
+std::vector<Z> naive_dft(std::span<const Z> x) {
+    const int n = static_cast<int>(x.size());
+    std::vector<Z> out(n);
+    for (int k = 0; k != n; ++k)
+        for (int j = 0; j != n; ++j)
+            out[k] += x[j] * fft_twiddle<Z>(static_cast<long long>(j) * k % n, n);
+    return out;
+}
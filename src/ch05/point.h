@@ -0,0 +1,31 @@
+// point.h
+// Integer points, and rotating them by an angle in degrees.
+
+#pragma once
+
+#include <cmath>
+#include <numbers>
+
+class Point {
+public:
+    int x, y;
+    Point(int x = 0, int y = 0) : x{x}, y{y} {}
+};
+
+// cos and sin of an angle given in degrees
+struct Rotation {
+    float c, s;
+    explicit Rotation(double degrees)
+        : c{static_cast<float>(std::cos(degrees * std::numbers::pi / 180))},
+          s{static_cast<float>(std::sin(degrees * std::numbers::pi / 180))} {}
+};
+
+// Rotate p counterclockwise about c. The arithmetic is done in float and
+// rounded to nearest (ties to even), exactly as the bulk kernels in point_kernels.h do it.
+inline Point rotate_point(Point p, Point c, Rotation r) {
+    const float dx = static_cast<float>(p.x - c.x);
+    const float dy = static_cast<float>(p.y - c.y);
+    const float rx = dx * r.c - dy * r.s;
+    const float ry = dx * r.s + dy * r.c;
+    return Point{c.x + static_cast<int>(std::nearbyint(rx)), c.y + static_cast<int>(std::nearbyint(ry))};
+}
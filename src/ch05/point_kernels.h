@@ -0,0 +1,219 @@
+// point_kernels.h
+// Translate and rotate whole arrays of points, with x and y coordinates in
+// separate arrays. The integer kernels rotate point i about its own pivot
+// (cx[i], cy[i]), which is what shapes need; the float kernels rotate every
+// point about one pivot, as when animating a set of vertices.
+// Each kernel has a portable scalar version and, on x86, SSE2 and AVX2
+// versions; the fastest one the CPU supports is picked on first use.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "point.h"
+
+// x86 SIMD kernels (SSE2/AVX2, picked at run time) need GCC/Clang target attributes
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+inline void translate_scalar(int* x, int* y, std::size_t n, int dx, int dy) {
+    for (std::size_t i = 0; i != n; ++i) {
+        x[i] += dx;
+        y[i] += dy;
+    }
+}
+
+inline void rotate_scalar(int* x, int* y, const int* cx, const int* cy, std::size_t n, Rotation r) {
+    for (std::size_t i = 0; i != n; ++i) {
+        const Point p = rotate_point(Point{x[i], y[i]}, Point{cx[i], cy[i]}, r);
+        x[i] = p.x;
+        y[i] = p.y;
+    }
+}
+
+inline void translate_scalar(float* x, float* y, std::size_t n, float dx, float dy) {
+    for (std::size_t i = 0; i != n; ++i) {
+        x[i] += dx;
+        y[i] += dy;
+    }
+}
+
+inline void rotate_scalar(float* x, float* y, std::size_t n, float cx, float cy, Rotation r) {
+    for (std::size_t i = 0; i != n; ++i) {
+        const float dx = x[i] - cx;
+        const float dy = y[i] - cy;
+        x[i] = cx + (dx * r.c - dy * r.s);
+        y[i] = cy + (dx * r.s + dy * r.c);
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// SSE2: four points per step; the remainder goes through the scalar code
+__attribute__((target("sse2")))
+inline void translate_sse2(int* x, int* y, std::size_t n, int dx, int dy) {
+    const __m128i vdx = _mm_set1_epi32(dx), vdy = _mm_set1_epi32(dy);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto px = reinterpret_cast<__m128i*>(x + i);
+        auto py = reinterpret_cast<__m128i*>(y + i);
+        _mm_storeu_si128(px, _mm_add_epi32(_mm_loadu_si128(px), vdx));
+        _mm_storeu_si128(py, _mm_add_epi32(_mm_loadu_si128(py), vdy));
+    }
+    translate_scalar(x + i, y + i, n - i, dx, dy);
+}
+
+__attribute__((target("sse2")))
+inline void rotate_sse2(int* x, int* y, const int* cx, const int* cy, std::size_t n, Rotation r) {
+    const __m128 c = _mm_set1_ps(r.c), s = _mm_set1_ps(r.s);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto px = reinterpret_cast<__m128i*>(x + i);
+        auto py = reinterpret_cast<__m128i*>(y + i);
+        const __m128i vcx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cx + i));
+        const __m128i vcy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cy + i));
+        const __m128 dx = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128(px), vcx));
+        const __m128 dy = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128(py), vcy));
+        const __m128 rx = _mm_sub_ps(_mm_mul_ps(dx, c), _mm_mul_ps(dy, s));
+        const __m128 ry = _mm_add_ps(_mm_mul_ps(dx, s), _mm_mul_ps(dy, c));
+        _mm_storeu_si128(px, _mm_add_epi32(vcx, _mm_cvtps_epi32(rx)));
+        _mm_storeu_si128(py, _mm_add_epi32(vcy, _mm_cvtps_epi32(ry)));
+    }
+    rotate_scalar(x + i, y + i, cx + i, cy + i, n - i, r);
+}
+
+__attribute__((target("sse2")))
+inline void translate_sse2(float* x, float* y, std::size_t n, float dx, float dy) {
+    const __m128 vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), vdx));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), vdy));
+    }
+    translate_scalar(x + i, y + i, n - i, dx, dy);
+}
+
+__attribute__((target("sse2")))
+inline void rotate_sse2(float* x, float* y, std::size_t n, float cx, float cy, Rotation r) {
+    const __m128 c = _mm_set1_ps(r.c), s = _mm_set1_ps(r.s);
+    const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), vcx);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), vcy);
+        _mm_storeu_ps(x + i, _mm_add_ps(vcx, _mm_sub_ps(_mm_mul_ps(dx, c), _mm_mul_ps(dy, s))));
+        _mm_storeu_ps(y + i, _mm_add_ps(vcy, _mm_add_ps(_mm_mul_ps(dx, s), _mm_mul_ps(dy, c))));
+    }
+    rotate_scalar(x + i, y + i, n - i, cx, cy, r);
+}
+
+// AVX2: eight points per step
+__attribute__((target("avx2")))
+inline void translate_avx2(int* x, int* y, std::size_t n, int dx, int dy) {
+    const __m256i vdx = _mm256_set1_epi32(dx), vdy = _mm256_set1_epi32(dy);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto px = reinterpret_cast<__m256i*>(x + i);
+        auto py = reinterpret_cast<__m256i*>(y + i);
+        _mm256_storeu_si256(px, _mm256_add_epi32(_mm256_loadu_si256(px), vdx));
+        _mm256_storeu_si256(py, _mm256_add_epi32(_mm256_loadu_si256(py), vdy));
+    }
+    translate_scalar(x + i, y + i, n - i, dx, dy);
+}
+
+__attribute__((target("avx2")))
+inline void rotate_avx2(int* x, int* y, const int* cx, const int* cy, std::size_t n, Rotation r) {
+    const __m256 c = _mm256_set1_ps(r.c), s = _mm256_set1_ps(r.s);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto px = reinterpret_cast<__m256i*>(x + i);
+        auto py = reinterpret_cast<__m256i*>(y + i);
+        const __m256i vcx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cx + i));
+        const __m256i vcy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cy + i));
+        const __m256 dx = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_loadu_si256(px), vcx));
+        const __m256 dy = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_loadu_si256(py), vcy));
+        const __m256 rx = _mm256_sub_ps(_mm256_mul_ps(dx, c), _mm256_mul_ps(dy, s));
+        const __m256 ry = _mm256_add_ps(_mm256_mul_ps(dx, s), _mm256_mul_ps(dy, c));
+        _mm256_storeu_si256(px, _mm256_add_epi32(vcx, _mm256_cvtps_epi32(rx)));
+        _mm256_storeu_si256(py, _mm256_add_epi32(vcy, _mm256_cvtps_epi32(ry)));
+    }
+    rotate_scalar(x + i, y + i, cx + i, cy + i, n - i, r);
+}
+
+__attribute__((target("avx2")))
+inline void translate_avx2(float* x, float* y, std::size_t n, float dx, float dy) {
+    const __m256 vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), vdx));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), vdy));
+    }
+    translate_scalar(x + i, y + i, n - i, dx, dy);
+}
+
+__attribute__((target("avx2")))
+inline void rotate_avx2(float* x, float* y, std::size_t n, float cx, float cy, Rotation r) {
+    const __m256 c = _mm256_set1_ps(r.c), s = _mm256_set1_ps(r.s);
+    const __m256 vcx = _mm256_set1_ps(cx), vcy = _mm256_set1_ps(cy);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), vcx);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), vcy);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(vcx, _mm256_sub_ps(_mm256_mul_ps(dx, c), _mm256_mul_ps(dy, s))));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(vcy, _mm256_add_ps(_mm256_mul_ps(dx, s), _mm256_mul_ps(dy, c))));
+    }
+    rotate_scalar(x + i, y + i, n - i, cx, cy, r);
+}
+
+#endif // HAVE_X86_KERNELS
+
+// One implementation of each kernel
+struct Point_kernels {
+    const char* name;
+    void (*translate)(int*, int*, std::size_t, int, int);
+    void (*rotate)(int*, int*, const int*, const int*, std::size_t, Rotation);
+    void (*translatef)(float*, float*, std::size_t, float, float);
+    void (*rotatef)(float*, float*, std::size_t, float, float, Rotation);
+};
+
+inline const Point_kernels scalar_kernels{"scalar", translate_scalar, rotate_scalar, translate_scalar, rotate_scalar};
+#ifdef HAVE_X86_KERNELS
+inline const Point_kernels sse2_kernels{"sse2", translate_sse2, rotate_sse2, translate_sse2, rotate_sse2};
+inline const Point_kernels avx2_kernels{"avx2", translate_avx2, rotate_avx2, translate_avx2, rotate_avx2};
+#endif
+
+// All implementations this CPU can run, slowest first
+inline std::vector<const Point_kernels*> supported_point_kernels() {
+    std::vector<const Point_kernels*> v{&scalar_kernels};
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) v.push_back(&sse2_kernels);
+    if (__builtin_cpu_supports("avx2")) v.push_back(&avx2_kernels);
+#endif
+    return v;
+}
+
+inline const Point_kernels& point_kernels() {
+    static const Point_kernels& best = *supported_point_kernels().back();
+    return best;
+}
+
+inline void translate_points(int* x, int* y, std::size_t n, int dx, int dy) {
+    point_kernels().translate(x, y, n, dx, dy);
+}
+
+inline void rotate_points(int* x, int* y, const int* cx, const int* cy, std::size_t n, int degrees) {
+    point_kernels().rotate(x, y, cx, cy, n, Rotation{static_cast<double>(degrees)});
+}
+
+inline void translate_points(float* x, float* y, std::size_t n, float dx, float dy) {
+    point_kernels().translatef(x, y, n, dx, dy);
+}
+
+inline void rotate_points(float* x, float* y, std::size_t n, float cx, float cy, double degrees) {
+    point_kernels().rotatef(x, y, n, cx, cy, Rotation{degrees});
+}
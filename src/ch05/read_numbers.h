@@ -0,0 +1,109 @@
+// read_numbers.h
+// Fast numeric input: reading whitespace-separated numbers into a container V
+// of doubles (the Vector of class.cpp, or std::vector<double>), which needs
+// push_back(), reserve(), size(), begin() and end().
+//
+// operator>> goes through the locale one value at a time. These readers find
+// the numbers in raw characters and convert them with std::from_chars. Like a
+// loop over operator>>, they stop at the first token that is not a number.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "parallel_for.h"
+
+constexpr bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Append the whitespace-separated numbers in [first, last) to v. Returns last,
+// or the start of the first token that is not a number.
+template<typename V>
+const char* parse_doubles(const char* first, const char* last, V& v) {
+    for (;;) {
+        while (first != last && is_space(*first)) ++first;
+        if (first == last) return last;
+        const char* p = first + (*first == '+');  // from_chars does not accept a leading '+'
+        double d;
+        auto [end, ec] = std::from_chars(p, last, d);
+        if (ec != std::errc{}) return first;
+        v.push_back(d);
+        first = end;
+    }
+}
+
+// A streaming reader: reads large blocks and parses every
+// complete token in each block, carrying a token cut off at the end of a
+// block over to the next one
+template<typename V>
+V read_fast(std::istream& is, std::size_t block = 1 << 20) {
+    V v;
+    std::vector<char> buf(block);
+    std::size_t kept = 0;  // Bytes of an unfinished token at the front of buf
+    for (;;) {
+        if (kept == buf.size()) buf.resize(2 * buf.size());  // A token longer than the block
+        is.read(buf.data() + kept, static_cast<std::streamsize>(buf.size() - kept));
+        const bool at_end = !is;
+        const char* first = buf.data();
+        const char* last = first + kept + is.gcount();
+        const char* stop = last;
+        if (!at_end)
+            while (stop != first && !is_space(stop[-1])) --stop;
+        if (parse_doubles(first, stop, v) != stop || at_end) return v;
+        kept = last - stop;
+        std::memmove(buf.data(), stop, kept);
+    }
+}
+
+// Read all the numbers in a file. With threads > 1 the file is cut into
+// pieces at whitespace, the pieces are parsed concurrently, and the results
+// are copied into one V reserved to the exact total.
+template<typename V>
+V read_file(const std::string& path, int threads = 1) {
+    Mapped_file f{path};
+    const char* first = f.data();
+    const char* last = first + f.size();
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(f.size() / (1 << 16)) + 1));
+
+    std::vector<const char*> cut{first};
+    for (int t = 1; t != threads; ++t) {
+        const char* c = std::max(cut.back(), first + f.size() * t / threads);
+        while (c != last && !is_space(*c)) ++c;
+        cut.push_back(c);
+    }
+    cut.push_back(last);
+
+    std::vector<V> parts(threads);
+    std::vector<char> complete(threads);   // not vector<bool>: its packed bits would be shared between threads
+    auto parse = [&](int t) { complete[t] = parse_doubles(cut[t], cut[t + 1], parts[t]) == cut[t + 1]; };
+    parallel_for(threads, threads, [&](int t0, int t1) {
+        for (int t = t0; t != t1; ++t) parse(t);
+    });
+
+    // Everything up to and including the first piece that stopped early
+    int used = 0;
+    long long total = 0;
+    while (used != threads) {
+        total += parts[used].size();
+        if (!complete[used++]) break;
+    }
+    if (used == 1) return std::move(parts[0]);
+    using Size = decltype(parts[0].size());
+    if (std::cmp_greater(total, std::numeric_limits<Size>::max())) throw std::length_error("read_file");
+    V v;
+    v.reserve(static_cast<Size>(total));
+    for (int t = 0; t != used; ++t)
+        for (double d : parts[t]) v.push_back(d);
+    return v;
+}
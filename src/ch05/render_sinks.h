@@ -0,0 +1,159 @@
+// render_sinks.h
+// Render_sink, the interface shapes draw themselves through, and three
+// implementations. Drawing through std::cout with std::endl flushes on every
+// line. These sinks collect a whole frame in memory instead: as text, as a
+// compact binary command stream, or as pixels.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "point.h"
+
+// Where shapes draw themselves
+class Render_sink {
+public:
+    virtual void circle(Point c, int r) = 0;
+    virtual void triangle(Point a, Point b, Point c) = 0;
+    virtual void end_frame() = 0;          // Deliver everything drawn since the last frame
+    virtual ~Render_sink() {}
+};
+
+// The same text as Shape::draw(), built in a reusable buffer and written
+// to os with one write per frame
+class Text_sink : public Render_sink {
+private:
+    std::ostream& os;
+    std::string buf;
+
+    void put(int v) {
+        char tmp[16];
+        auto [end, ec] = std::to_chars(tmp, tmp + sizeof tmp, v);
+        buf.append(tmp, end);
+    }
+
+    void put(Point p) {
+        buf += '(';
+        put(p.x);
+        buf += ',';
+        put(p.y);
+        buf += ')';
+    }
+
+public:
+    explicit Text_sink(std::ostream& os, std::size_t reserve = 1 << 20) : os{os} { buf.reserve(reserve); }
+
+    void circle(Point c, int r) override {
+        buf += "Drawing Circle at ";
+        put(c);
+        buf += " with radius ";
+        put(r);
+        buf += '\n';
+    }
+
+    void triangle(Point a, Point b, Point c) override {
+        buf += "Drawing Triangle with vertices at ";
+        put(a);
+        buf += ", ";
+        put(b);
+        buf += ", ";
+        put(c);
+        buf += '\n';
+    }
+
+    void end_frame() override {
+        os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        os.flush();
+        buf.clear();  // Keeps the capacity for the next frame
+    }
+};
+
+// Binary commands: an opcode byte followed by int32 coordinates in native byte order
+//   'C' x y r
+//   'T' x1 y1 x2 y2 x3 y3
+class Command_sink : public Render_sink {
+private:
+    std::ostream& os;
+    std::vector<char> buf;
+
+    void put(std::int32_t v) {
+        const auto p = reinterpret_cast<const char*>(&v);
+        buf.insert(buf.end(), p, p + sizeof v);
+    }
+
+public:
+    explicit Command_sink(std::ostream& os, std::size_t reserve = 1 << 20) : os{os} { buf.reserve(reserve); }
+
+    void circle(Point c, int r) override {
+        buf.push_back('C');
+        put(c.x); put(c.y); put(r);
+    }
+
+    void triangle(Point a, Point b, Point c) override {
+        buf.push_back('T');
+        put(a.x); put(a.y); put(b.x); put(b.y); put(c.x); put(c.y);
+    }
+
+    void end_frame() override {
+        os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        os.flush();
+        buf.clear();
+    }
+};
+
+// Rasterizes filled circles and triangles into an 8-bit framebuffer in memory.
+// The pixels hold the finished frame until clear().
+class Framebuffer_sink : public Render_sink {
+private:
+    int w, h;
+    std::vector<std::uint8_t> pixels;
+    std::uint8_t ink = 255;
+
+    // Twice the signed area of (a, b, p): which side of a->b the point p is on
+    static long long edge(Point a, Point b, int px, int py) {
+        return static_cast<long long>(b.x - a.x) * (py - a.y) - static_cast<long long>(b.y - a.y) * (px - a.x);
+    }
+
+public:
+    Framebuffer_sink(int width, int height)
+        : w{width}, h{height}, pixels(static_cast<std::size_t>(width) * height) {}
+
+    int width() const { return w; }
+    int height() const { return h; }
+    std::uint8_t at(int x, int y) const { return pixels[static_cast<std::size_t>(y) * w + x]; }
+    void clear() { std::fill(pixels.begin(), pixels.end(), 0); }
+
+    // One horizontal span per row of the disk
+    void circle(Point c, int r) override {
+        const int y0 = std::max(c.y - r, 0), y1 = std::min(c.y + r, h - 1);
+        for (int y = y0; y <= y1; ++y) {
+            const int dy = y - c.y;
+            const int half = static_cast<int>(std::sqrt(static_cast<double>(r) * r - static_cast<double>(dy) * dy));
+            const int x0 = std::max(c.x - half, 0), x1 = std::min(c.x + half, w - 1);
+            if (x0 <= x1)
+                std::fill_n(&pixels[static_cast<std::size_t>(y) * w + x0], x1 - x0 + 1, ink);
+        }
+    }
+
+    // Pixels of the bounding box that lie on the inner side of all three edges
+    void triangle(Point a, Point b, Point c) override {
+        if (edge(a, b, c.x, c.y) < 0) std::swap(b, c);  // Make the winding counterclockwise
+        const int x0 = std::max(std::min({a.x, b.x, c.x}), 0), x1 = std::min(std::max({a.x, b.x, c.x}), w - 1);
+        const int y0 = std::max(std::min({a.y, b.y, c.y}), 0), y1 = std::min(std::max({a.y, b.y, c.y}), h - 1);
+        for (int y = y0; y <= y1; ++y) {
+            std::uint8_t* row = &pixels[static_cast<std::size_t>(y) * w];
+            for (int x = x0; x <= x1; ++x)
+                if (edge(a, b, x, y) >= 0 && edge(b, c, x, y) >= 0 && edge(c, a, x, y) >= 0)
+                    row[x] = ink;
+        }
+    }
+
+    void end_frame() override {}
+};
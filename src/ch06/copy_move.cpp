@@ -1,80 +1,215 @@
 // copy_move_demo.cpp
 // Demonstrates C++ copy and move semantics with detailed logging and comments. Renamed class to "Handle" to reflect resource handling.
+// Build with -DHANDLE_LOGGING=0 (as the ch06_copy_move_quiet target does) to compile the logging out.
+// With -DLIFECYCLE_TRACING=1 (the ch06_copy_move target) Handles are also counted by lifecycle_trace.h;
+// set LIFECYCLE_TRACE=<file> to record a binary trace for ch06_lifecycle_report.
 
 #include <iostream>
 #include <vector>
 #include <utility> // For std::move
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <type_traits>
+#include <array>
+
+#include "id_allocator.h"
+#include "lifecycle_trace.h"
+
+#ifndef HANDLE_LOGGING
+#define HANDLE_LOGGING 1
+#endif
+
+#if HANDLE_LOGGING
+#define HANDLE_LOG(msg) (std::cout << msg)
+#else
+#define HANDLE_LOG(msg) ((void)0)
+#endif
+
+// Where a Handle's int comes from: the global heap...
+struct Heap_storage {
+    static int* make(int value) { return new int(value); }
+    static void release(int* p) { delete p; }
+};
+
+// ...or a per-thread slab allocator: ints are carved out of large slabs and
+// recycled through a free list, so after warm-up neither allocation nor
+// release takes a lock or calls the global heap. Each slab records the pool
+// that owns it, and memory freed on another thread is handed back to that
+// pool (through a lock-free list it takes over when its own list runs dry),
+// so a slot is only ever reused by the thread whose slab it lives in.
+// The slabs are released when their thread exits, so a pooled Handle must
+// not outlive the thread that created it.
+class Int_pool {
+private:
+    union Slot {
+        Slot* next;   // While free
+        int value;    // While in use
+    };
+    static constexpr std::size_t slab_bytes = 128 * 1024;
+
+    // Aligned to its size, so the slab (and its owner) of a slot is found by masking its address
+    struct alignas(slab_bytes) Slab {
+        Int_pool* owner;
+        Slot slots[(slab_bytes - sizeof(Int_pool*)) / sizeof(Slot)];
+    };
+    static_assert(sizeof(Slab) == slab_bytes);
+
+    Slot* free_ = nullptr;
+    std::atomic<Slot*> remote_free_{nullptr};   // Pushed by other threads
+    std::vector<std::unique_ptr<Slab>> slabs_;
+
+    static Slab* slab_of(Slot* s) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(s) & ~(slab_bytes - 1));
+    }
+
+    void refill() {
+        free_ = remote_free_.exchange(nullptr, std::memory_order_acquire);
+        if (free_) return;
+        slabs_.push_back(std::make_unique<Slab>());
+        Slab* slab = slabs_.back().get();
+        slab->owner = this;
+        for (Slot& s : slab->slots) {
+            s.next = free_;
+            free_ = &s;
+        }
+    }
+
+    void push_remote(Slot* s) {
+        Slot* head = remote_free_.load(std::memory_order_relaxed);
+        do {
+            s->next = head;
+        } while (!remote_free_.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+public:
+    static Int_pool& local() {
+        thread_local Int_pool pool;
+        return pool;
+    }
+
+    int* allocate(int value) {
+        if (!free_) refill();
+        Slot* s = free_;
+        free_ = s->next;
+        s->value = value;
+        return &s->value;
+    }
+
+    void deallocate(int* p) {
+        Slot* s = reinterpret_cast<Slot*>(p);  // value is the first (and only) member
+        Int_pool* owner = slab_of(s)->owner;
+        if (owner != this) {
+            owner->push_remote(s);
+            return;
+        }
+        s->next = free_;
+        free_ = s;
+    }
+};
+
+struct Pool_storage {
+    static int* make(int value) { return Int_pool::local().allocate(value); }
+    static void release(int* p) { if (p) Int_pool::local().deallocate(p); }
+};
+
+// Unique IDs, shared by every kind of Handle. Handles may be created on any thread,
+// so each thread takes IDs from its own block instead of bumping one global counter.
+struct Handle_ids {};
+using Handle_id_allocator = Id_allocator<Handle_ids>;
 
 // A simple class that manages a dynamic resource and logs copy/move operations.
-class Handle {
+// Storage decides where the resource lives; Heap_handle is the heap-allocating version.
+// Handle<T> (below) generalizes it to any payload, stored inline when small.
+template<typename Storage>
+class Basic_handle : private Traced<Basic_handle<Storage>> {
 private:
-    int* data_;       // Pointer to a dynamic integer, simulating a resource
-    int id_;          // Unique ID for each instance (for logging)
-    static int counter_; // Static counter to assign unique IDs
+    using Trace = Traced<Basic_handle<Storage>>;
+
+    int* data_;         // Pointer to a dynamic integer, simulating a resource
+    std::uint64_t id_;  // Unique ID for each instance (for logging)
+
+    int* acquire(int value) {
+        this->traced_allocation();
+        return Storage::make(value);
+    }
+
+    void drop() {
+        if (data_) this->traced_deallocation();
+        Storage::release(data_);
+    }
 
 public:
     // Default constructor
-    Handle() : data_(new int(0)), id_(++counter_) {
-        std::cout << "[Default Constructor]   " << "Handle#" << id_ << " created, data_ = " << *data_ << " at " << data_ << "\n";
+    Basic_handle() : data_(acquire(0)), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Default Constructor]   " << "Handle#" << id_ << " created, data_ = " << *data_ << " at " << data_ << "\n");
     }
 
     // Parameterized constructor
-    Handle(int value) : data_(new int(value)), id_(++counter_) {
-        std::cout << "[Param Constructor]     " << "Handle#" << id_ << " created with value " << *data_ << " at " << data_ << "\n";
+    Basic_handle(int value) : data_(acquire(value)), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Param Constructor]     " << "Handle#" << id_ << " created with value " << *data_ << " at " << data_ << "\n");
     }
 
     // Copy constructor
-    Handle(const Handle& other) : data_(new int(*other.data_)), id_(++counter_) {
-        std::cout << "[Copy Constructor]      " << "Handle#" << id_
+    Basic_handle(const Basic_handle& other) : Trace(other), data_(acquire(*other.data_)), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Copy Constructor]      " << "Handle#" << id_
                   << " copied from Handle#" << other.id_
-                  << ", data_ = " << *data_ << " at " << data_ << "\n";
+                  << ", data_ = " << *data_ << " at " << data_ << "\n");
     }
 
     // Copy assignment operator
-    Handle& operator=(const Handle& other) {
+    Basic_handle& operator=(const Basic_handle& other) {
+        Trace::operator=(other);
         if (this == &other) {
-            std::cout << "[Copy Assignment]       " << "Self-assignment detected for Handle#" << id_ << "\n";
+            HANDLE_LOG("[Copy Assignment]       " << "Self-assignment detected for Handle#" << id_ << "\n");
             return *this;
         }
-        delete data_;                                  // Clean up existing resource
-        data_ = new int(*other.data_);                 // Allocate new resource and copy
-        std::cout << "[Copy Assignment]       " << "Handle#" << id_
+        drop();                                        // Clean up existing resource
+        data_ = acquire(*other.data_);                 // Allocate new resource and copy
+        HANDLE_LOG("[Copy Assignment]       " << "Handle#" << id_
                   << " assigned from Handle#" << other.id_
-                  << ", data_ = " << *data_ << " at " << data_ << "\n";
+                  << ", data_ = " << *data_ << " at " << data_ << "\n");
         return *this;
     }
 
     // Move constructor
-    Handle(Handle&& other) noexcept : data_(other.data_), id_(++counter_) {
+    Basic_handle(Basic_handle&& other) noexcept : Trace(std::move(other)), data_(other.data_), id_(Handle_id_allocator::next()) {
         other.data_ = nullptr; // Take ownership, leave other in a valid but empty state
-        std::cout << "[Move Constructor]      " << "Handle#" << id_
+        HANDLE_LOG("[Move Constructor]      " << "Handle#" << id_
                   << " moved from Handle#" << other.id_
-                  << ", data_ = " << *data_ << " at " << data_ << "\n";
+                  << ", data_ = " << *data_ << " at " << data_ << "\n");
     }
 
     // Move assignment operator
-    Handle& operator=(Handle&& other) noexcept {
+    Basic_handle& operator=(Basic_handle&& other) noexcept {
+        Trace::operator=(std::move(other));
         if (this == &other) {
-            std::cout << "[Move Assignment]       " << "Self-move detected for Handle#" << id_ << "\n";
+            HANDLE_LOG("[Move Assignment]       " << "Self-move detected for Handle#" << id_ << "\n");
             return *this;
         }
-        delete data_;           // Free existing resource
-        data_ = other.data_;    // Transfer ownership
-        other.data_ = nullptr;  // Leave other in a valid state
-        std::cout << "[Move Assignment]       " << "Handle#" << id_
+        drop();                   // Free existing resource
+        data_ = other.data_;      // Transfer ownership
+        other.data_ = nullptr;    // Leave other in a valid state
+        HANDLE_LOG("[Move Assignment]       " << "Handle#" << id_
                   << " moved-assign from Handle#" << other.id_
-                  << ", data_ at " << data_ << "\n";
+                  << ", data_ at " << data_ << "\n");
         return *this;
     }
 
     // Destructor
-    ~Handle() {
+    ~Basic_handle() {
         if (data_) {
-            std::cout << "[Destructor]           " << "Handle#" << id_ << " destroyed, deleting data_ at " << data_ << "\n";
+            HANDLE_LOG("[Destructor]           " << "Handle#" << id_ << " destroyed, deleting data_ at " << data_ << "\n");
         } else {
-            std::cout << "[Destructor]           " << "Handle#" << id_ << " destroyed, no data to delete (moved-from)\n";
+            HANDLE_LOG("[Destructor]           " << "Handle#" << id_ << " destroyed, no data to delete (moved-from)\n");
         }
-        delete data_;
+        drop();
     }
 
     // Accessor
@@ -88,49 +223,317 @@ public:
     }
 };
 
-// Initialize static counter_
-int Handle::counter_ = 0;
+using Heap_handle = Basic_handle<Heap_storage>;
+using Pooled_handle = Basic_handle<Pool_storage>;
+
+// Handle<T> keeps a payload of up to Inline_size bytes inside the Handle itself and
+// heap-allocates only larger ones. A Handle<int> never touches the allocator, and a
+// moved-from Handle<int> still holds an int, so its accessors need no null test.
+// Moves are noexcept either way: only types with noexcept moves are stored inline.
+template<typename T, std::size_t Inline_size = 16>
+class Handle : private Traced<Handle<T, Inline_size>> {
+public:
+    static constexpr bool stored_inline = sizeof(T) <= Inline_size
+        && std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>;
+
+private:
+    using Trace = Traced<Handle<T, Inline_size>>;
+
+    std::conditional_t<stored_inline, T, T*> data_;  // The payload, or a pointer to it (nullptr once moved from)
+    std::uint64_t id_;                               // Unique ID for each instance (for logging)
+
+    template<typename... Args>
+    auto acquire(Args&&... args) {
+        if constexpr (stored_inline) {
+            return T(std::forward<Args>(args)...);
+        } else {
+            this->traced_allocation();
+            return new T(std::forward<Args>(args)...);
+        }
+    }
+
+    auto copy_of(const Handle& other) {
+        if constexpr (stored_inline)
+            return other.data_;
+        else
+            return other.data_ ? acquire(*other.data_) : static_cast<T*>(nullptr);
+    }
+
+    void drop() {
+        if constexpr (!stored_inline) {
+            if (data_) this->traced_deallocation();
+            delete data_;
+        }
+    }
+
+    const T* payload() const {
+        if constexpr (stored_inline)
+            return &data_;
+        else
+            return data_;
+    }
+
+    T* payload() { return const_cast<T*>(std::as_const(*this).payload()); }
+
+    // For the log: the payload (if T can be printed) and where it lives
+    std::string describe() const {
+        const T* p = payload();
+        if (!p) return "nullptr";
+        std::ostringstream os;
+        if constexpr (requires { os << *p; })
+            os << *p;
+        else
+            os << "?";
+        os << (stored_inline ? " inline at " : " at ") << p;
+        return os.str();
+    }
+
+public:
+    Handle() : data_(acquire()), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Default Constructor]   " << "Handle#" << id_ << " created, data_ = " << describe() << "\n");
+    }
+
+    Handle(const T& value) : data_(acquire(value)), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Param Constructor]     " << "Handle#" << id_ << " created with value " << describe() << "\n");
+    }
+
+    Handle(const Handle& other) : Trace(other), data_(copy_of(other)), id_(Handle_id_allocator::next()) {
+        HANDLE_LOG("[Copy Constructor]      " << "Handle#" << id_
+                  << " copied from Handle#" << other.id_ << ", data_ = " << describe() << "\n");
+    }
+
+    Handle& operator=(const Handle& other) {
+        Trace::operator=(other);
+        if (this == &other) {
+            HANDLE_LOG("[Copy Assignment]       " << "Self-assignment detected for Handle#" << id_ << "\n");
+            return *this;
+        }
+        if constexpr (stored_inline) {
+            data_ = other.data_;
+        } else if (data_ && other.data_) {
+            *data_ = *other.data_;  // Reuse our own payload
+        } else {
+            T* p = copy_of(other);
+            drop();
+            data_ = p;
+        }
+        HANDLE_LOG("[Copy Assignment]       " << "Handle#" << id_
+                  << " assigned from Handle#" << other.id_ << ", data_ = " << describe() << "\n");
+        return *this;
+    }
+
+    Handle(Handle&& other) noexcept : Trace(std::move(other)), data_(std::move(other.data_)), id_(Handle_id_allocator::next()) {
+        if constexpr (!stored_inline) other.data_ = nullptr;
+        HANDLE_LOG("[Move Constructor]      " << "Handle#" << id_
+                  << " moved from Handle#" << other.id_ << ", data_ = " << describe() << "\n");
+    }
+
+    Handle& operator=(Handle&& other) noexcept {
+        Trace::operator=(std::move(other));
+        if (this == &other) {
+            HANDLE_LOG("[Move Assignment]       " << "Self-move detected for Handle#" << id_ << "\n");
+            return *this;
+        }
+        if constexpr (stored_inline) {
+            data_ = std::move(other.data_);
+        } else {
+            drop();
+            data_ = other.data_;
+            other.data_ = nullptr;
+        }
+        HANDLE_LOG("[Move Assignment]       " << "Handle#" << id_
+                  << " moved-assign from Handle#" << other.id_ << ", data_ = " << describe() << "\n");
+        return *this;
+    }
+
+    ~Handle() {
+        HANDLE_LOG("[Destructor]           " << "Handle#" << id_ << " destroyed, data_ = " << describe() << "\n");
+        drop();
+    }
+
+    // Accessor (a moved-from heap payload reads as T{})
+    T getValue() const {
+        const T* p = payload();
+        return p ? *p : T{};
+    }
+
+    // Mutator
+    void setValue(const T& value) {
+        if (T* p = payload()) *p = value;
+    }
+};
 
 // A function that returns a Handle object by value
-Handle createHandle(int value) {
-    Handle temp(value);
+Handle<int> createHandle(int value) {
+    Handle<int> temp(value);
     std::cout << "[createHandle]             Returning Handle#" << temp.getValue() << " by value\n";
     return temp; // Should invoke move constructor in C++11+ (RVO or move)
 }
 
-int main() {
+// Push n Handles through a std::vector (growing, so existing elements are moved),
+// then destroy them; returns the elapsed milliseconds
+template<typename H>
+double bench_vector_push(int n) {
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        std::vector<H> vec;
+        for (int i = 0; i != n; ++i)
+            vec.push_back(H(i));
+        if (vec.back().getValue() != n - 1) std::cout << "unexpected value\n";
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+// Split n iterations of work over the given number of threads; returns the elapsed milliseconds
+template<typename F>
+double run_on_threads(int threads, int n, F work) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t != threads; ++t)
+        pool.emplace_back(work, n / threads);
+    for (auto& t : pool)
+        t.join();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+std::atomic<std::uint64_t> shared_id_counter{1};  // What a global atomic counter would cost
+std::atomic<std::uint64_t> bench_sink{0};         // Keeps the benchmark loops from being optimized away
+struct Bench_ids {};
+
+// T's lifecycle events while f runs
+template<typename T, typename F>
+Lifecycle_counts count_events(F f) {
+    const Lifecycle_counts before = lifecycle_counts<T>();
+    f();
+    Lifecycle_counts d = lifecycle_counts<T>();
+    for (int e = 0; e != lifecycle_events; ++e)
+        d[e] -= before[e];
+    return d;
+}
+
+bool check(const char* what, bool ok) {
+    std::cout << (ok ? "ok      " : "FAILED  ") << what << "\n";
+    return ok;
+}
+
+// Usage: ch06_copy_move [benchmark_size]  (default 10000000; the benchmark runs only without logging)
+int main(int argc, char* argv[]) {
+    if (const char* path = std::getenv("LIFECYCLE_TRACE"))
+        lifecycle_trace_start(path);
+
     std::cout << "--- 1. Default Construction ---\n";
-    Handle h1;                 // Default constructor
+    Handle<int> h1;            // Default constructor
 
     std::cout << "\n--- 2. Parameterized Construction ---\n";
-    Handle h2(42);             // Param constructor
+    Handle<int> h2(42);        // Param constructor
 
     std::cout << "\n--- 3. Copy Construction ---\n";
-    Handle h3 = h2;            // Copy constructor
+    Handle<int> h3 = h2;       // Copy constructor
 
     std::cout << "\n--- 4. Copy Assignment ---\n";
     h1 = h2;                 // Copy assignment
 
     std::cout << "\n--- 5. Move Construction with std::move ---\n";
-    Handle h4 = std::move(h2); // Move constructor
+    Handle<int> h4 = std::move(h2); // Move constructor
 
     std::cout << "\n--- 6. Move Assignment with std::move ---\n";
     h3 = std::move(h4);      // Move assignment
 
     std::cout << "\n--- 7. Returning by Value (createHandle) ---\n";
-    Handle h5 = createHandle(99); // createHandle returns by value
+    Handle<int> h5 = createHandle(99); // createHandle returns by value
 
     std::cout << "\n--- 8. Move Semantics in std::vector ---\n";
-    std::vector<Handle> vec;
+    std::vector<Handle<int>> vec;  // Small payloads live inside the elements: no allocations
     vec.reserve(3);
-    vec.push_back(Handle(7)); // Temporary Handle(7) is moved into the vector
-    vec.push_back(Handle(8));
-    vec.push_back(Handle(9));
+    vec.push_back(Handle<int>(7)); // Temporary Handle(7) is moved into the vector
+    vec.push_back(Handle<int>(8));
+    vec.push_back(Handle<int>(9));
 
     std::cout << "\n--- 9. std::move on a local object inserted to vector ---\n";
-    Handle local(100);
+    Handle<int> local(100);
     vec.push_back(std::move(local)); // Move local into vector
 
+    std::cout << "\n--- 10. Pooled Handles behave the same ---\n";
+    Pooled_handle p1(5);
+    Pooled_handle p2 = p1;
+    Pooled_handle p3 = std::move(p1);
+    std::cout << "p2 = " << p2.getValue() << ", p3 = " << p3.getValue() << ", p1 (moved-from) = " << p1.getValue() << "\n";
+
+    if constexpr (!HANDLE_LOGGING) {
+        const int n = argc > 1 ? std::atoi(argv[1]) : 10'000'000;
+        std::cout << "\n--- 11. Benchmark: " << n << " Handles through a std::vector (ms) ---\n";
+        std::cout << "heap: " << bench_vector_push<Heap_handle>(n)
+                  << "  pool: " << bench_vector_push<Pooled_handle>(n)
+                  << "  inline (Handle<int>): " << bench_vector_push<Handle<int>>(n) << "\n";
+
+        std::cout << "\n--- 12. Benchmark: " << n << " IDs / pooled Handles from 1-64 threads (ms) ---\n";
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            const double shared = run_on_threads(threads, n, [](int k) {
+                std::uint64_t sum = 0;
+                for (int i = 0; i != k; ++i) sum += shared_id_counter.fetch_add(1, std::memory_order_relaxed);
+                bench_sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+            const double blocks = run_on_threads(threads, n, [](int k) {
+                std::uint64_t sum = 0;
+                for (int i = 0; i != k; ++i) sum += Id_allocator<Bench_ids>::next();
+                bench_sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+            const double handles = run_on_threads(threads, n, [](int k) {
+                std::uint64_t sum = 0;
+                for (int i = 0; i != k; ++i) {
+                    Pooled_handle h(i);
+                    sum += static_cast<std::uint64_t>(h.getValue());
+                }
+                bench_sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+            std::cout << threads << " threads: shared atomic counter " << shared
+                      << "  per-thread ID blocks " << blocks << "  Pooled_handle construct+destroy " << handles << "\n";
+        }
+    }
+
+    if constexpr (LIFECYCLE_TRACING) {
+        std::cout << "\n--- 13. Copy/move/alloc counts ---\n";
+        const int n = HANDLE_LOGGING ? 3 : 100'000;
+        bool ok = true;
+
+        auto small = count_events<Handle<int>>([n] {
+            std::vector<Handle<int>> v;
+            v.reserve(n);
+            for (int i = 0; i != n; ++i) v.push_back(Handle<int>(i));
+            Handle<int> c = v[0];
+            v[1] = std::move(c);
+        });
+        ok &= check("Handle<int> through a vector: no allocations", small[int(Lifecycle_event::allocate)] == 0);
+        ok &= check("Handle<int> through a vector: one move per element",
+                    small[int(Lifecycle_event::move_construct)] == static_cast<std::uint64_t>(n));
+        ok &= check("Handle<int> through a vector: one copy, one move-assignment",
+                    small[int(Lifecycle_event::copy_construct)] == 1 && small[int(Lifecycle_event::move_assign)] == 1);
+        ok &= check("Handle<int> through a vector: all destroyed",
+                    small[int(Lifecycle_event::destroy)] == small[int(Lifecycle_event::construct)] + n + 1);
+
+        using Big = std::array<int, 16>;
+        auto big = count_events<Handle<Big>>([n] {
+            std::vector<Handle<Big>> v;
+            v.reserve(n);
+            for (int i = 0; i != n; ++i) v.push_back(Handle<Big>(Big{i}));
+            Handle<Big> c = v[0];
+            v[1] = std::move(c);
+        });
+        ok &= check("Handle<array<int, 16>>: one allocation per payload, moves allocate nothing",
+                    big[int(Lifecycle_event::allocate)] == static_cast<std::uint64_t>(n) + 1);
+        ok &= check("Handle<array<int, 16>>: every allocation freed",
+                    big[int(Lifecycle_event::deallocate)] == big[int(Lifecycle_event::allocate)]);
+        if (!ok) return 1;
+    }
+
+    lifecycle_trace_stop();
+    if constexpr (LIFECYCLE_TRACING) {
+        std::cout << "\n--- 14. Lifecycle counts so far ---\n";
+        lifecycle_report(std::cout);
+    }
+
     std::cout << "\n--- End of main: Destruction begins ---\n";
     return 0;
 }
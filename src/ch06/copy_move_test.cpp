@@ -1,15 +1,20 @@
 #include <iostream>
 #include <vector>
 #include <utility>  // for std::move
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+#include "id_allocator.h"
 
 class Handle {
 public:
-    Handle() : data(new int(0)), id(counter++) {}
+    Handle() : data(new int(0)), id(Ids::next()) {}
 
-    explicit Handle(int v) : data(new int(v)), id(counter++) {}
+    explicit Handle(int v) : data(new int(v)), id(Ids::next()) {}
 
     // copy
-    Handle(const Handle& other) : data(new int(*other.data)), id(counter++) {}
+    Handle(const Handle& other) : data(new int(*other.data)), id(Ids::next()) {}
 
     Handle& operator=(const Handle& other) {
         // WARN: self-assignment detection
@@ -24,7 +29,7 @@ public:
     }
 
     // move
-    Handle(Handle&& other) noexcept : data(other.data), id(counter++) {
+    Handle(Handle&& other) noexcept : data(other.data), id(Ids::next()) {
         other.data = nullptr;
     }
 
@@ -48,6 +53,8 @@ public:
         return data ? *data : 0;
     }
     
+    std::uint64_t getId() const noexcept { return id; }
+
     void setData(int d) {
         if (data) {
             *data = d;
@@ -55,9 +62,12 @@ public:
     }
 
 private:
+    // WARN: a static int counter is a data race once Handles are made on several threads;
+    // ids come from per-thread blocks instead
+    using Ids = Id_allocator<Handle>;
+
     int* data;
-    int id;
-    inline static int counter = 0;
+    std::uint64_t id;
 };
 
 Handle createHandle(int d) {
@@ -66,6 +76,39 @@ Handle createHandle(int d) {
 }
 
 
+// Construct Handles on many threads at once (copies and moves take ids too)
+// and check that no id was handed out twice
+bool ids_unique_under_threads(int threads, int per_thread) {
+    std::vector<std::vector<std::uint64_t>> seen(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t != threads; ++t)
+        pool.emplace_back([&seen, t, per_thread] {
+            for (int i = 0; i != per_thread; ++i) {
+                Handle h(i);
+                Handle c = h;
+                Handle m = std::move(c);
+                seen[t].push_back(h.getId());
+                seen[t].push_back(c.getId());
+                seen[t].push_back(m.getId());
+            }
+        });
+    for (auto& t : pool)
+        t.join();
+
+    std::vector<std::uint64_t> all;
+    for (const auto& v : seen)
+        all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    return std::adjacent_find(all.begin(), all.end()) == all.end()
+        && all.size() == static_cast<std::size_t>(threads) * per_thread * 3;
+}
+
 int main() {
     std::cout << "hello world\n";
+
+    for (int threads : {1, 4, 16, 64}) {
+        const bool ok = ids_unique_under_threads(threads, 20'000);
+        std::cout << threads << " threads: ids " << (ok ? "unique" : "DUPLICATED") << "\n";
+        if (!ok) return 1;
+    }
 }
\ No newline at end of file
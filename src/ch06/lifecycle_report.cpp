@@ -0,0 +1,102 @@
+// lifecycle_report.cpp
+// Summarizes a binary trace written by lifecycle_trace_start()/lifecycle_trace_stop()
+// (see include/lifecycle_trace.h): event counts per type and per thread, the time
+// span covered, and optionally the first events in order.
+//
+// Usage: ch06_lifecycle_report <trace file> [number of events to list]
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lifecycle_trace.h"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <trace file> [events to list]\n";
+        return 2;
+    }
+    const long list = argc > 2 ? std::atol(argv[2]) : 0;
+
+    std::ifstream in{argv[1], std::ios::binary};
+    if (!in) {
+        std::cerr << "cannot open " << argv[1] << '\n';
+        return 1;
+    }
+
+    char magic[8];
+    Lifecycle_trace_footer f{};
+    in.read(magic, sizeof magic);
+    in.seekg(-static_cast<std::streamoff>(sizeof f), std::ios::end);
+    in.read(reinterpret_cast<char*>(&f), sizeof f);
+    if (!in || std::memcmp(magic, "LCTRACE1", 8) != 0 || std::memcmp(f.magic, "LCTRACE1", 8) != 0) {
+        std::cerr << argv[1] << " is not a lifecycle trace (or was not finished by lifecycle_trace_stop)\n";
+        return 1;
+    }
+    if (f.record_size != sizeof(Lifecycle_record)) {
+        std::cerr << "record size " << f.record_size << " does not match this build's " << sizeof(Lifecycle_record) << '\n';
+        return 1;
+    }
+
+    std::vector<std::string> names(f.type_count);
+    in.seekg(static_cast<std::streamoff>(f.names_offset));
+    for (auto& n : names) {
+        std::uint32_t len = 0;
+        in.read(reinterpret_cast<char*>(&len), sizeof len);
+        n.resize(len);
+        in.read(n.data(), len);
+    }
+    if (!in) {
+        std::cerr << "truncated names section\n";
+        return 1;
+    }
+
+    std::vector<Lifecycle_counts> per_type(names.size(), Lifecycle_counts{});
+    std::map<std::uint32_t, std::uint64_t> per_thread;
+    std::uint64_t records = 0, first = 0, last = 0;
+
+    in.seekg(8);
+    const std::uint64_t count = (f.names_offset - 8) / sizeof(Lifecycle_record);
+    std::vector<Lifecycle_record> block(4096);
+    while (records != count) {
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(block.size(), count - records));
+        in.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(n * sizeof(Lifecycle_record)));
+        if (!in) {
+            std::cerr << "truncated record section\n";
+            return 1;
+        }
+        for (std::size_t i = 0; i != n; ++i) {
+            const Lifecycle_record& r = block[i];
+            if (r.type >= names.size() || static_cast<int>(r.event) >= lifecycle_events) {
+                std::cerr << "bad record " << records + i << '\n';
+                return 1;
+            }
+            ++per_type[r.type][static_cast<int>(r.event)];
+            ++per_thread[r.thread];
+            if (records + i == 0 || r.time_ns < first) first = r.time_ns;
+            if (r.time_ns > last) last = r.time_ns;
+            if (static_cast<long>(records + i) < list)
+                std::cout << std::setw(12) << r.time_ns << " ns  thread " << r.thread << "  "
+                          << std::setw(9) << lifecycle_event_names[static_cast<int>(r.event)] << "  "
+                          << names[r.type] << " at 0x" << std::hex << r.object << std::dec << '\n';
+        }
+        records += n;
+    }
+
+    std::cout << records << " events over " << (last - first) / 1e6 << " ms on " << per_thread.size() << " thread(s)\n";
+    for (std::size_t t = 0; t != names.size(); ++t) {
+        std::cout << "  " << names[t] << "\n   ";
+        for (int e = 0; e != lifecycle_events; ++e)
+            std::cout << ' ' << lifecycle_event_names[e] << ' ' << per_type[t][e];
+        std::cout << '\n';
+    }
+    for (const auto& [thread, n] : per_thread)
+        std::cout << "  thread " << thread << ": " << n << " events\n";
+    return 0;
+}
@@ -1,20 +1,578 @@
 #include <thread>
 #include <iostream>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Big Vectors are mapped directly where POSIX mmap is available (with a
+// transparent huge page hint on Linux), and threads are placed on NUMA
+// nodes where Linux reports more than one
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#define HAVE_NUMA_AFFINITY 1
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// A type is Hashable if std::hash gives it a hash that cannot throw, and its
+// values can be compared for equality (needed to resolve collisions)
 template<typename T>
-concept Hashable = true;
+concept Hashable = std::equality_comparable<T> && requires(const T& x) {
+    { std::hash<T>{}(x) } noexcept -> std::same_as<std::size_t>;
+};
+
+// Memory for Vector: large blocks are mapped straight from the OS, aligned to
+// 2 MiB and marked as candidates for transparent huge pages (fewer page faults
+// and TLB misses on multi-GB arrays); the pages are not touched here, so they
+// are placed on whichever NUMA node first writes them
+struct Big_alloc
+{
+    static constexpr std::size_t huge_page = std::size_t{2} << 20;
+
+    static std::size_t mapped_size(std::size_t bytes) { return (bytes + huge_page - 1) / huge_page * huge_page; }
+
+    static void* allocate(std::size_t bytes, std::size_t align)
+    {
+#ifdef HAVE_MMAP
+        if (bytes >= huge_page) {
+            const std::size_t len = mapped_size(bytes);
+            void* p = mmap(nullptr, len + huge_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc{};
+            // keep the 2 MiB aligned part
+            auto* raw = static_cast<char*>(p);
+            char* start = raw + (huge_page - reinterpret_cast<std::uintptr_t>(raw) % huge_page) % huge_page;
+            if (start != raw) munmap(raw, start - raw);
+            if (start + len != raw + len + huge_page) munmap(start + len, raw + len + huge_page - (start + len));
+#ifdef MADV_HUGEPAGE
+            madvise(start, len, MADV_HUGEPAGE);  // only a hint: ignored where THP is off
+#endif
+            return start;
+        }
+#endif
+        return ::operator new(bytes, std::align_val_t{align});
+    }
+
+    static void deallocate(void* p, std::size_t bytes, std::size_t align)
+    {
+#ifdef HAVE_MMAP
+        if (bytes >= huge_page) {
+            munmap(p, mapped_size(bytes));
+            return;
+        }
+#endif
+        ::operator delete(p, std::align_val_t{align});
+    }
+};
 
+#ifdef HAVE_NUMA_AFFINITY
+// The CPUs of each NUMA node, from sysfs; a single entry (or none) means there is nothing to place
+inline const std::vector<cpu_set_t>& numa_nodes()
+{
+    static const std::vector<cpu_set_t> nodes = [] {
+        std::vector<cpu_set_t> v;
+        for (int node = 0;; ++node) {
+            std::ifstream in{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+            std::string list;
+            if (!std::getline(in, list)) break;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            std::istringstream ranges{list};
+            for (std::string r; std::getline(ranges, r, ',');) {   // e.g. "0-15,32-47"
+                const auto dash = r.find('-');
+                const int lo = std::atoi(r.c_str());
+                const int hi = dash == std::string::npos ? lo : std::atoi(r.c_str() + dash + 1);
+                for (int c = lo; c <= hi && c < CPU_SETSIZE; ++c) CPU_SET(c, &set);
+            }
+            v.push_back(set);
+        }
+        return v;
+    }();
+    return nodes;
+}
+#endif
+
+// Run f(first, last) over [0, n) split into one contiguous chunk per thread
+// (0 threads: one per hardware thread). With several NUMA nodes, thread t runs
+// on node t % nodes, so the pages of its chunk that it touches first are
+// placed there. The first exception thrown by f is rethrown once all are done.
+// A chunk whose thread cannot be started runs on the calling thread instead.
+template<typename F>
+void parallel_chunks(std::size_t n, unsigned threads, F f)
+{
+    constexpr std::size_t min_chunk = 1 << 16;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(1, n / min_chunk)));
+    if (threads == 1) {
+        f(std::size_t{0}, n);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&](unsigned t) {
+        try {
+            f(n * t / threads, n * (t + 1) / threads);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock{error_mutex};
+            if (!error) error = std::current_exception();
+        }
+    };
+
+#ifdef HAVE_NUMA_AFFINITY
+    const auto& nodes = numa_nodes();   // read here: an exception escaping a worker would terminate
+#endif
+    std::vector<std::thread> pool;
+    unsigned started = 0;
+    try {
+        pool.reserve(threads);
+        for (; started != threads; ++started)
+            pool.emplace_back([&, t = started] {
+#ifdef HAVE_NUMA_AFFINITY
+                if (nodes.size() > 1)
+                    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &nodes[t % nodes.size()]);
+#endif
+                run(t);
+            });
+    }
+    catch (...) {   // std::system_error (or bad_alloc): out of threads
+    }
+    for (unsigned t = started; t != threads; ++t) run(t);
+    for (auto& t : pool) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// Elements are value-initialized by several threads at once (first touch), so
+// startup of a multi-GB Vector is not one thread taking every page fault.
+// Element types whose constructor may throw are initialized by one thread,
+// so that a failure can be rolled back.
 template<Hashable T>
 class Vector
 {
 private:
     T* elem;
-    int sz;
+    std::size_t sz;
+
+    static std::size_t bytes(std::size_t s)
+    {
+        if (s > SIZE_MAX / sizeof(T)) throw std::length_error{"Vector: too many elements"};
+        return s * sizeof(T);
+    }
+public:
+    explicit Vector(std::size_t s, unsigned threads = 0);
+    ~Vector();
+    Vector(const Vector&) = delete;
+    Vector& operator=(const Vector&) = delete;
+
+    std::size_t size() const { return sz; }
+    T& operator[](std::size_t i) { return elem[i]; }
+    const T& operator[](std::size_t i) const { return elem[i]; }
+    T* begin() { return elem; }
+    T* end() { return elem + sz; }
+    const T* begin() const { return elem; }
+    const T* end() const { return elem + sz; }
+
+    // assign x to every element, in parallel
+    void fill(const T& x, unsigned threads = 0)
+    {
+        parallel_chunks(sz, threads, [&](std::size_t b, std::size_t e) { std::fill(elem + b, elem + e, x); });
+    }
+
+    // assign g(i) to element i, in parallel: g is called concurrently, for indices in any order
+    template<typename G>
+    void generate(G g, unsigned threads = 0)
+    {
+        parallel_chunks(sz, threads, [&](std::size_t b, std::size_t e) {
+            for (std::size_t i = b; i != e; ++i) elem[i] = g(i);
+        });
+    }
+};
+
+template<Hashable T>
+Vector<T>::Vector(std::size_t s, unsigned threads)
+    : elem(static_cast<T*>(Big_alloc::allocate(bytes(s), alignof(T)))), sz(s)
+{
+    if constexpr (std::is_nothrow_default_constructible_v<T>) {
+        try {
+            // throws (bad_alloc reading the NUMA layout) only before any element is constructed
+            parallel_chunks(sz, threads, [this](std::size_t b, std::size_t e) {
+                std::uninitialized_value_construct(elem + b, elem + e);
+            });
+        }
+        catch (...) {
+            Big_alloc::deallocate(elem, bytes(sz), alignof(T));
+            throw;
+        }
+    }
+    else {
+        try {
+            std::uninitialized_value_construct(elem, elem + sz);
+        }
+        catch (...) {
+            Big_alloc::deallocate(elem, sz * sizeof(T), alignof(T));
+            throw;
+        }
+    }
+}
+
+template<Hashable T>
+Vector<T>::~Vector()
+{
+    std::destroy(elem, elem + sz);   // on this thread: a destructor must not fail for want of threads
+    Big_alloc::deallocate(elem, sz * sizeof(T), alignof(T));
+}
+
+// Flat_map<K, V>: open addressing, in the style of Swiss tables.
+// Keys and values live in one array of slots (no node per element), and a
+// parallel array of control bytes holds, per slot, 0x80 for empty or 7 bits
+// of the key's hash. A lookup compares 16 control bytes at once (SSE2) against
+// those 7 bits, so it looks at keys only where the bits match, and stops at
+// the first empty slot. Capacity is a power of two, kept at most 7/8 full.
+// Probing is linear, slot by slot, which lets erase() shift later elements
+// back into the hole instead of leaving a tombstone: lookups never wade
+// through deleted slots, and no rehash is needed to clean them up.
+// Pointers to elements are invalidated by insertion (growth) and erasure.
+template<Hashable K, typename V>
+class Flat_map
+{
+    static constexpr std::size_t group = 16;
+    static constexpr std::int8_t empty = static_cast<std::int8_t>(0x80);
+
+    struct Slot
+    {
+        K key;
+        [[no_unique_address]] V value;
+    };
+
+    std::int8_t* ctrl = nullptr;  // capacity + group bytes: the first group is repeated at the end, so a window never wraps
+    Slot* slots = nullptr;
+    std::size_t mask = 0;         // capacity - 1
+    std::size_t count = 0;
+
+    // std::hash is the identity for integers; mix it so that both the low bits
+    // (position) and the top 7 bits (control byte) depend on the whole key
+    static std::size_t hash(const K& k)
+    {
+        std::uint64_t h = std::hash<K>{}(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+
+    static std::int8_t h2(std::size_t h) { return static_cast<std::int8_t>(h >> 57); }   // 7 bits: never 0x80
+    std::size_t home(std::size_t h) const { return h & mask; }
+
+    // Bit i set if control byte pos + i equals b
+    std::uint32_t match(std::size_t pos, std::int8_t b) const
+    {
+#if defined(__SSE2__)
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl + pos));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(w, _mm_set1_epi8(b))));
+#else
+        std::uint32_t m = 0;
+        for (std::size_t i = 0; i != group; ++i) m |= std::uint32_t{ctrl[pos + i] == b} << i;
+        return m;
+#endif
+    }
+
+    void set_ctrl(std::size_t i, std::int8_t b)
+    {
+        ctrl[i] = b;
+        if (i < group) ctrl[mask + 1 + i] = b;  // keep the mirrored copy in step
+    }
+
+    // The slot holding k, or capacity() if there is none
+    std::size_t locate(const K& k, std::size_t h) const
+    {
+        if (!slots) return 0;
+        const std::int8_t b = h2(h);
+        for (std::size_t pos = home(h);; pos = (pos + group) & mask) {
+            for (std::uint32_t m = match(pos, b); m; m &= m - 1) {
+                const std::size_t i = (pos + std::countr_zero(m)) & mask;
+                if (slots[i].key == k) return i;
+            }
+            if (match(pos, empty)) return capacity();
+        }
+    }
+
+    // First empty slot on k's probe sequence (there always is one)
+    std::size_t first_empty(std::size_t h) const
+    {
+        for (std::size_t pos = home(h);; pos = (pos + group) & mask)
+            if (const std::uint32_t m = match(pos, empty))
+                return (pos + std::countr_zero(m)) & mask;
+    }
+
+    void release()
+    {
+        if (!slots) return;
+        for (std::size_t i = 0; i <= mask; ++i)
+            if (ctrl[i] != empty) std::destroy_at(slots + i);
+        ::operator delete(slots, std::align_val_t{alignof(Slot)});
+        delete[] ctrl;
+        slots = nullptr;
+        ctrl = nullptr;
+    }
+
+    void rehash(std::size_t cap)
+    {
+        cap = std::max(cap, group);
+        auto* new_ctrl = new std::int8_t[cap + group];
+        std::fill_n(new_ctrl, cap + group, empty);
+        auto* new_slots = static_cast<Slot*>(::operator new(cap * sizeof(Slot), std::align_val_t{alignof(Slot)}));
+
+        std::int8_t* old_ctrl = ctrl;
+        Slot* old_slots = slots;
+        const std::size_t old_cap = slots ? mask + 1 : 0;
+        ctrl = new_ctrl;
+        slots = new_slots;
+        mask = cap - 1;
+        for (std::size_t i = 0; i != old_cap; ++i) {
+            if (old_ctrl[i] == empty) continue;
+            const std::size_t h = hash(old_slots[i].key);
+            const std::size_t j = first_empty(h);
+            std::construct_at(slots + j, std::move(old_slots[i]));
+            std::destroy_at(old_slots + i);
+            set_ctrl(j, h2(h));
+        }
+        if (old_slots) ::operator delete(old_slots, std::align_val_t{alignof(Slot)});
+        delete[] old_ctrl;
+    }
+
+public:
+    Flat_map() = default;
+    Flat_map(const Flat_map&) = delete;
+    Flat_map& operator=(const Flat_map&) = delete;
+    ~Flat_map() { release(); }
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return slots ? mask + 1 : 0; }
+
+    // Room for n elements without growing
+    void reserve(std::size_t n)
+    {
+        const std::size_t cap = std::bit_ceil(n + n / 7 + 1);
+        if (cap > capacity()) rehash(cap);
+    }
+
+    V* find(const K& k)
+    {
+        const std::size_t i = locate(k, hash(k));
+        return i == capacity() ? nullptr : &slots[i].value;
+    }
+
+    bool contains(const K& k) const { return locate(k, hash(k)) != capacity(); }
+
+    // Insert k with value v unless k is present; returns the element and whether it was inserted
+    std::pair<V*, bool> insert(const K& k, V v)
+    {
+        const std::size_t h = hash(k);
+        const std::size_t i = locate(k, h);
+        if (i != capacity()) return {&slots[i].value, false};
+        if ((count + 1) * 8 > capacity() * 7) rehash(capacity() * 2);
+        const std::size_t j = first_empty(h);
+        std::construct_at(slots + j, Slot{k, std::move(v)});
+        set_ctrl(j, h2(h));
+        ++count;
+        return {&slots[j].value, true};
+    }
+
+    V& operator[](const K& k) { return *insert(k, V{}).first; }
+
+    bool erase(const K& k)
+    {
+        std::size_t hole = locate(k, hash(k));
+        if (hole == capacity()) return false;
+        std::destroy_at(slots + hole);
+        set_ctrl(hole, empty);
+        --count;
+        // Backward shift: move each following element whose home is not
+        // between the hole and itself into the hole, until an empty slot
+        for (std::size_t j = (hole + 1) & mask; ctrl[j] != empty; j = (j + 1) & mask) {
+            const std::size_t h = hash(slots[j].key);
+            if (((j - home(h)) & mask) < ((j - hole) & mask)) continue;  // already as close to home as it can be
+            std::construct_at(slots + hole, std::move(slots[j]));
+            std::destroy_at(slots + j);
+            set_ctrl(hole, ctrl[j]);
+            set_ctrl(j, empty);
+            hole = j;
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        release();
+        mask = 0;
+        count = 0;
+    }
+
+    template<typename F>
+    void for_each(F f)
+    {
+        for (std::size_t i = 0; i != capacity(); ++i)
+            if (ctrl[i] != empty) f(std::as_const(slots[i].key), slots[i].value);
+    }
+};
+
+// Flat_set<K>: a Flat_map without values
+template<Hashable K>
+class Flat_set
+{
+    struct Nothing {};
+    Flat_map<K, Nothing> map;
 public:
-    explicit Vector(int s) : elem(new T[s]), sz(s) {}
+    std::size_t size() const { return map.size(); }
+    void reserve(std::size_t n) { map.reserve(n); }
+    bool insert(const K& k) { return map.insert(k, {}).second; }
+    bool contains(const K& k) const { return map.contains(k); }
+    bool erase(const K& k) { return map.erase(k); }
 };
 
-int main() {
+// insert, find (half hits, half misses) and erase of n random keys, repeated
+// so that every size does about the same work; nanoseconds per operation
+template<typename Map>
+void bench_map_ops(const char* name, const std::vector<std::uint64_t>& keys, const std::vector<std::uint64_t>& misses, long reps)
+{
+    using clock = std::chrono::steady_clock;
+    double t_insert = 0, t_find = 0, t_erase = 0;
+    std::uint64_t found = 0;
+    for (long r = 0; r != reps; ++r) {
+        Map m;
+        auto t0 = clock::now();
+        for (auto k : keys) m[k] = k;
+        auto t1 = clock::now();
+        for (std::size_t i = 0; i != keys.size(); ++i) {
+            found += m.find(keys[i]) != nullptr;
+            found += m.find(misses[i]) != nullptr;
+        }
+        auto t2 = clock::now();
+        for (auto k : keys) m.erase(k);
+        auto t3 = clock::now();
+        t_insert += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        t_find += std::chrono::duration<double, std::nano>(t2 - t1).count();
+        t_erase += std::chrono::duration<double, std::nano>(t3 - t2).count();
+    }
+    const double ops = double(reps) * keys.size();
+    std::cout << "    " << name << ": insert " << t_insert / ops << "  find " << t_find / (2 * ops)
+              << "  erase " << t_erase / ops
+              << (found == static_cast<std::uint64_t>(ops) ? "" : "  (WRONG RESULTS)") << "\n";
+}
+
+// std::unordered_map's find returns an iterator; give it the same shape as Flat_map's
+struct Std_map
+{
+    std::unordered_map<std::uint64_t, std::uint64_t> m;
+    std::uint64_t& operator[](std::uint64_t k) { return m[k]; }
+    std::uint64_t* find(std::uint64_t k)
+    {
+        auto p = m.find(k);
+        return p == m.end() ? nullptr : &p->second;
+    }
+    void erase(std::uint64_t k) { m.erase(k); }
+};
+
+// Time until a Vector<int> of the given size is ready to use, on 1, 2, 4, ...
+// threads, against std::vector (one thread); then a parallel fill of it
+void bench_time_to_ready(double gib)
+{
+    using clock = std::chrono::steady_clock;
+    const auto n = static_cast<std::size_t>(gib * (1 << 30) / sizeof(int));
+    auto ms = [](clock::time_point t0) { return std::chrono::duration<double, std::milli>(clock::now() - t0).count(); };
+
+    std::cout << "time to ready, " << gib << " GiB of int (ms):\n";
+    {
+        auto t0 = clock::now();
+        std::vector<int> v(n);
+        std::cout << "  std::vector: " << ms(t0) << "\n";
+    }
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned t = 1; t <= hw; t *= 2) {
+        auto t0 = clock::now();
+        Vector<int> v(n, t);
+        const double ready = ms(t0);
+        t0 = clock::now();
+        v.fill(1, t);
+        const double fill = ms(t0);
+        t0 = clock::now();
+        v.generate([](std::size_t i) { return static_cast<int>(i); }, t);
+        const double generate = ms(t0);
+        std::cout << "  Vector, " << t << " thread(s): " << ready << "  (then fill " << fill
+                  << ", generate " << generate << (n == 0 || v[n - 1] == static_cast<int>(n - 1) ? ")" : ", WRONG)") << "\n";
+    }
+}
+
+// Usage: ch07_constrained_templates [--bench [max_keys [GiB]]]
+// (the benchmarks run only with --bench; defaults 10000000 keys and 1 GiB;
+// 100M keys, or a 64 GiB Vector, need that much memory)
+int main(int argc, char* argv[]) {
+    const bool bench = argc > 1 && std::string_view{argv[1]} == "--bench";
     Vector<int> v1(10);
+    Vector<std::string> v2(100'000, 4);
+    v2.generate([](std::size_t i) { return std::to_string(i); });
+    std::cout << "v2[99999] = " << v2[99'999] << "\n";
+
+    static_assert(Hashable<std::string>);
+    static_assert(!Hashable<std::vector<int>>);   // no std::hash
+
+    Flat_map<std::string, int> ages;
+    ages["Ada"] = 36;
+    ages.insert("Alan", 41);
+    ages["Grace"] = 85;
+    ages.erase("Alan");
+    std::cout << "Ada " << *ages.find("Ada") << ", Alan " << (ages.contains("Alan") ? "present" : "absent")
+              << ", size " << ages.size() << "\n";
+
+    // every element still reachable after many erasures (no tombstones to lose them behind)
+    Flat_map<int, int> check;
+    for (int i = 0; i != 100'000; ++i) check[i] = i;
+    for (int i = 0; i < 100'000; i += 3) check.erase(i);
+    bool ok = check.size() == 66'666;
+    for (int i = 0; i != 100'000; ++i) ok &= (check.find(i) != nullptr) == (i % 3 != 0);
+    std::cout << "erase/find check " << (ok ? "ok" : "FAILED") << "\n";
+
     std::cout << "ok\n";
+    if (!bench) return 0;
+
+    const long max_keys = argc > 2 ? std::atol(argv[2]) : 10'000'000;
+    std::mt19937_64 gen{11};
+    std::cout << "insert / find / erase (ns per operation):\n";
+    for (long n = 1000; n <= max_keys; n *= 10) {
+        std::vector<std::uint64_t> keys(n), misses(n);
+        for (auto& k : keys) k = gen() | 1;        // odd keys are present...
+        for (auto& k : misses) k = gen() & ~1ULL;  // ...even ones are not
+        const long reps = std::max(1L, 10'000'000 / n);
+        std::cout << "  " << n << " keys:\n";
+        bench_map_ops<Flat_map<std::uint64_t, std::uint64_t>>("Flat_map          ", keys, misses, reps);
+        bench_map_ops<Std_map>("std::unordered_map", keys, misses, reps);
+    }
+
+    bench_time_to_ready(argc > 3 ? std::atof(argv[3]) : 1.0);
 }
\ No newline at end of file
@@ -1,25 +1,228 @@
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <random>
+#include <ranges>
+#include <string_view>
+#include <thread>
 
 using namespace std;
 
+// execution policies for sum() and count()
+namespace policy {
+    struct Sequential {};
+    struct Vectorized {};           // independent accumulators the compiler can keep in SIMD registers
+    struct Parallel {
+        unsigned threads = 0;       // 0: one per hardware thread
+    };
+
+    inline constexpr Sequential seq;
+    inline constexpr Vectorized unseq;
+    inline constexpr Parallel par;
+}
+
+// Split [0, n) into one contiguous chunk per thread and run f(first, last, chunk) on each;
+// small inputs stay on the calling thread, and so does any chunk whose thread cannot be started
+template<typename F>
+unsigned parallel_chunks(policy::Parallel p, size_t n, F f)
+{
+    constexpr size_t min_chunk = 1 << 16;
+    unsigned threads = p.threads ? p.threads : max(1u, thread::hardware_concurrency());
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, n / min_chunk)));
+    vector<thread> pool;
+    struct Join_all {
+        vector<thread>& pool;
+        ~Join_all() { for (auto& t : pool) t.join(); }
+    } join_all{pool};
+    unsigned started = 1;
+    try {
+        pool.reserve(threads - 1);
+        for (; started < threads; ++started)
+            pool.emplace_back(f, n * started / threads, n * (started + 1) / threads, started);
+    }
+    catch (...) {   // std::system_error (or bad_alloc): out of threads
+    }
+    for (unsigned t = started; t < threads; ++t) f(n * t / threads, n * (t + 1) / threads, t);
+    f(0, n / threads, 0u);
+    return threads;
+}
+
+// One per-thread result per cache line, so threads storing their results do not share lines
+template<typename T>
+struct alignas(64) Padded {
+    T value{};
+};
+
+// Kahan compensated summation: the rounding error of each addition is fed
+// into the next one, so the result does not drift with the number of elements
+// (this relies on strict floating-point semantics: no -ffast-math)
+template<typename It, typename Value>
+Value kahan_sum(It first, It last, Value v)
+{
+    Value c = 0;
+    for (; first != last; ++first) {
+        const Value y = static_cast<Value>(*first) - c;
+        const Value t = v + y;
+        c = (t - v) - y;
+        v = t;
+    }
+    return v;
+}
+
+// Pairwise summation over blocks of lanes: error grows with log(n) rather than n,
+// and the lanes are independent, so the inner loop vectorizes
+template<typename It, typename Value>
+Value pairwise_sum(It first, size_t n)
+{
+    constexpr size_t lanes = 8;
+    if (n <= 32 * lanes) {
+        Value acc[lanes] = {};
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes)
+            for (size_t j = 0; j != lanes; ++j) acc[j] += first[i + j];
+        for (; i != n; ++i) acc[0] += first[i];
+        return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+    }
+    const size_t half = n / 2 / lanes * lanes;
+    return pairwise_sum<It, Value>(first, half) + pairwise_sum<It, Value>(first + half, n - half);
+}
+
+// Plain accumulation in independent lanes (exact for integers, so no pairing is needed)
+template<typename It, typename Value>
+Value lane_sum(It first, size_t n)
+{
+    constexpr size_t lanes = 8;
+    Value acc[lanes] = {};
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes)
+        for (size_t j = 0; j != lanes; ++j) acc[j] += first[i + j];
+    for (; i != n; ++i) acc[0] += first[i];
+    Value v = 0;
+    for (auto a : acc) v += a;
+    return v;
+}
+
 // function templates
+// Floating-point sums are compensated (seq) or pairwise (unseq, par);
+// the vectorized and parallel versions need random access.
 template<typename Sequence, typename Value>
-Value sum(const Sequence s, Value v)
+Value sum(policy::Sequential, const Sequence& s, Value v)
 {
-    for (auto x : s) v += x;
+    if constexpr (floating_point<Value>)
+        return kahan_sum(ranges::begin(s), ranges::end(s), v);
+    for (const auto& x : s) v += x;
     return v;
 }
 
+template<typename Sequence, typename Value>
+Value sum(policy::Vectorized, const Sequence& s, Value v)
+{
+    if constexpr (!ranges::random_access_range<const Sequence>) {
+        return sum(policy::seq, s, v);
+    } else {
+        using It = ranges::iterator_t<const Sequence>;
+        const size_t n = ranges::size(s);
+        if constexpr (floating_point<Value>)
+            return v + pairwise_sum<It, Value>(ranges::begin(s), n);
+        else
+            return v + lane_sum<It, Value>(ranges::begin(s), n);
+    }
+}
+
+template<typename Sequence, typename Value>
+Value sum(policy::Parallel p, const Sequence& s, Value v)
+{
+    if constexpr (!ranges::random_access_range<const Sequence>) {
+        return sum(policy::seq, s, v);
+    } else {
+        const auto first = ranges::begin(s);
+        vector<Padded<Value>> partial(max(1u, p.threads ? p.threads : thread::hardware_concurrency()));
+        const unsigned used = parallel_chunks(p, ranges::size(s), [&](size_t b, size_t e, unsigned t) {
+            auto part = ranges::subrange(first + b, first + e);
+            partial[t].value = sum(policy::unseq, part, Value{});
+        });
+        return sum(policy::seq, ranges::subrange(partial.begin(), partial.begin() + used) | views::transform(&Padded<Value>::value), v);
+    }
+}
+
+template<typename Sequence, typename Value>
+Value sum(const Sequence& s, Value v)
+{
+    return sum(policy::seq, s, v);
+}
+
 // function objects
 template<typename T>
 class LessThan {
     const T val;
 public:
     LessThan(const T& v) : val(v) {}
-    bool operator()(const T& x) { return x < val; }
+    bool operator()(const T& x) const { return x < val; }
 };
 
+// predicate composition
+// and_/or_/not_ build one function object out of several predicates. Both sides
+// are always evaluated and their results combined with & | instead of && ||,
+// so a fused predicate is a single inlined expression without branches, and
+// one pass over the data replaces one pass per condition.
+// (Combine only cheap predicates without side effects.)
+template<typename P, typename Q>
+struct And {
+    P p;
+    Q q;
+    template<typename T>
+    bool operator()(const T& x) const { return static_cast<bool>(p(x)) & static_cast<bool>(q(x)); }
+};
+
+template<typename P, typename Q>
+struct Or {
+    P p;
+    Q q;
+    template<typename T>
+    bool operator()(const T& x) const { return static_cast<bool>(p(x)) | static_cast<bool>(q(x)); }
+};
+
+template<typename P>
+struct Not {
+    P p;
+    template<typename T>
+    bool operator()(const T& x) const { return !static_cast<bool>(p(x)); }
+};
+
+template<typename P, typename Q, typename... R>
+constexpr auto and_(P p, Q q, R... r)
+{
+    if constexpr (sizeof...(R) == 0) return And<P, Q>{p, q};
+    else return and_(And<P, Q>{p, q}, r...);
+}
+
+template<typename P, typename Q, typename... R>
+constexpr auto or_(P p, Q q, R... r)
+{
+    if constexpr (sizeof...(R) == 0) return Or<P, Q>{p, q};
+    else return or_(Or<P, Q>{p, q}, r...);
+}
+
+template<typename P>
+constexpr Not<P> not_(P p) { return {p}; }
+
+// range predicates, built on LessThan
+template<typename T>
+auto at_least(const T& lo) { return not_(LessThan{lo}); }                       // lo <= x
+
+template<typename T>
+auto in_range(const T& lo, const T& hi) { return and_(at_least(lo), LessThan{hi}); }   // lo <= x < hi
+
+template<typename T>
+auto outside(const T& lo, const T& hi) { return not_(in_range(lo, hi)); }        // x < lo or hi <= x
+
 // simplified `count_if`
 template<typename C, typename P>
 int count(const C& c, P pred)
@@ -32,26 +235,351 @@ int count(const C& c, P pred)
     return cnt;
 }
 
+template<typename C, typename P>
+ptrdiff_t count(policy::Sequential, const C& c, P pred)
+{
+    ptrdiff_t cnt = 0;
+    for (const auto& x : c)
+        if (pred(x)) cnt++;
+    return cnt;
+}
+
+// Branch-free: the predicate's result is added rather than tested
+template<typename C, typename P>
+ptrdiff_t count(policy::Vectorized, const C& c, P pred)
+{
+    if constexpr (!ranges::random_access_range<const C>) {
+        return count(policy::seq, c, pred);
+    } else {
+        constexpr size_t lanes = 8;
+        const auto first = ranges::begin(c);
+        const size_t n = ranges::size(c);
+        ptrdiff_t acc[lanes] = {};
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes)
+            for (size_t j = 0; j != lanes; ++j) acc[j] += static_cast<bool>(pred(first[i + j]));
+        for (; i != n; ++i) acc[0] += static_cast<bool>(pred(first[i]));
+        ptrdiff_t cnt = 0;
+        for (auto a : acc) cnt += a;
+        return cnt;
+    }
+}
+
+template<typename C, typename P>
+ptrdiff_t count(policy::Parallel p, const C& c, P pred)
+{
+    if constexpr (!ranges::random_access_range<const C>) {
+        return count(policy::seq, c, pred);
+    } else {
+        const auto first = ranges::begin(c);
+        vector<Padded<ptrdiff_t>> partial(max(1u, p.threads ? p.threads : thread::hardware_concurrency()));
+        const unsigned used = parallel_chunks(p, ranges::size(c), [&](size_t b, size_t e, unsigned t) {
+            partial[t].value = count(policy::unseq, ranges::subrange(first + b, first + e), pred);  // each thread its own copy of pred
+        });
+        ptrdiff_t cnt = 0;
+        for (unsigned t = 0; t != used; ++t) cnt += partial[t].value;
+        return cnt;
+    }
+}
+
+// copy the elements that satisfy pred
+// For trivially copyable elements it is branch-free: every element is written,
+// and the output advances only past kept ones. Other elements are copied only
+// when kept, so they need not be default constructible or assignable.
+template<typename C, typename P>
+auto filter(const C& c, P pred)
+{
+    using T = ranges::range_value_t<const C>;
+    vector<T> out;
+    if constexpr (is_trivially_copyable_v<T> && is_default_constructible_v<T>) {
+        out.resize(ranges::size(c));
+        size_t k = 0;
+        for (const auto& x : c) {
+            out[k] = x;
+            k += static_cast<bool>(pred(x));
+        }
+        out.resize(k);
+    } else {
+        for (const auto& x : c)
+            if (pred(x)) out.push_back(x);
+    }
+    return out;
+}
+
+// f(x) for each element x that satisfies pred
+// f is called only on those elements, so pred can guard it (p != nullptr, then *p)
+template<typename C, typename P, typename F>
+auto transform_if(const C& c, P pred, F f)
+{
+    vector<decay_t<invoke_result_t<F&, ranges::range_reference_t<const C>>>> out;
+    out.reserve(ranges::size(c));
+    for (const auto& x : c)
+        if (pred(x)) out.push_back(f(x));
+    return out;
+}
+
 // finally trick
+// The action runs from a destructor, so it should not throw (if it does, the program terminates).
 template<class F>
 struct FinalAction {
     F act;
 
-    explicit FinalAction(F f) : act(f) {}
-    ~FinalAction() { act(); };
+    explicit FinalAction(F f) noexcept(is_nothrow_move_constructible_v<F>) : act(std::move(f)) {}
+    FinalAction(const FinalAction&) = delete;              // one guard, one release
+    FinalAction& operator=(const FinalAction&) = delete;
+    ~FinalAction() noexcept { act(); };
 };
 
 template<class F>
 [[nodiscard]] auto finally(F f)
 {
-    return FinalAction{f};
+    return FinalAction<F>{std::move(f)};
 }
 
-int main()
+// request-scoped arena
+// Temporary buffers for one request are bumped out of chained blocks, and cleanups
+// registered with defer() (FinalAction semantics: each runs once, at the end, in
+// reverse order) are stored in the arena as well, callable and all, so neither
+// allocates on its own. reset() runs the cleanups and releases every buffer at
+// once; the blocks are kept for the next request.
+class Request_arena {
+    struct alignas(max_align_t) Block {
+        Block* next;
+        size_t size;
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    struct Cleanup {
+        void (*run)(Cleanup*) noexcept;
+        Cleanup* next;
+    };
+
+    template<class F>
+    struct Cleanup_for : Cleanup {
+        F act;
+
+        static void run(Cleanup* c) noexcept
+        {
+            auto* self = static_cast<Cleanup_for*>(c);
+            self->act();
+            self->~Cleanup_for();
+        }
+    };
+
+    size_t block_size;
+    Block* first = nullptr;      // all blocks, in order of use
+    Block* current = nullptr;    // the one being bumped (nullptr: none yet this request)
+    size_t used = 0;             // bytes used in current
+    Cleanup* cleanups = nullptr; // most recently deferred first
+
+    // Move on to the next block with room for n bytes, reusing blocks from earlier requests
+    void next_block(size_t n)
+    {
+        Block* b = current ? current->next : first;
+        while (b && b->size < n) b = b->next;
+        if (!b) {
+            const size_t size = max(block_size, n);
+            void* p = std::malloc(sizeof(Block) + size);
+            if (!p) throw bad_alloc{};
+            b = ::new (p) Block{nullptr, size};
+            Block*& link = current ? current->next : first;
+            b->next = link;
+            link = b;
+        }
+        current = b;
+        used = 0;
+    }
+
+public:
+    explicit Request_arena(size_t block_size = 64 * 1024) : block_size{block_size} {}
+    Request_arena(const Request_arena&) = delete;
+    Request_arena& operator=(const Request_arena&) = delete;
+
+    ~Request_arena()
+    {
+        reset();
+        while (first) {
+            Block* b = first;
+            first = b->next;
+            std::free(b);
+        }
+    }
+
+    // n bytes aligned to align (a power of two, at most alignof(max_align_t))
+    void* allocate(size_t n, size_t align = alignof(max_align_t))
+    {
+        size_t at = (used + align - 1) & ~(align - 1);
+        if (!current || at + n > current->size) {
+            next_block(n);
+            at = 0;
+        }
+        used = at + n;
+        return current->data() + at;
+    }
+
+    // storage for n Ts (not constructed)
+    template<typename T>
+    T* allocate_array(size_t n)
+    {
+        static_assert(alignof(T) <= alignof(max_align_t));
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // run f() at the next reset()
+    template<class F>
+    void defer(F f)
+    {
+        static_assert(is_nothrow_invocable_v<F&>, "a deferred cleanup must not throw");
+        using C = Cleanup_for<F>;
+        static_assert(alignof(C) <= alignof(max_align_t));
+        cleanups = ::new (allocate(sizeof(C), alignof(C))) C{{&C::run, cleanups}, std::move(f)};
+    }
+
+    void reset() noexcept
+    {
+        while (cleanups) {
+            Cleanup* c = cleanups;
+            cleanups = c->next;
+            c->run(c);
+        }
+        current = nullptr;
+        used = 0;
+    }
+};
+
+// A FinalAction that ends the request: whatever was allocated and deferred in
+// the arena since is released when it goes out of scope
+[[nodiscard]] inline auto request_scope(Request_arena& a)
+{
+    return finally([&a]() noexcept { a.reset(); });
+}
+
+template<typename F>
+double time_ms(F f)
+{
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// sum() and count() over n floats with each policy, and the parallel ones
+// on 1, 2, 4, ... threads; sums are compared with a double-precision reference
+void bench_sum_count(size_t n)
+{
+    vector<float> v(n);
+    mt19937 gen{42};
+    uniform_real_distribution<float> dist{0.0f, 1.0f};
+    for (auto& x : v) x = dist(gen);
+    const double exact = sum(policy::par, v, 0.0);
+
+    cout << "sum/count over " << n << " floats (ms, relative error of the float sum):\n";
+    auto report = [&](const char* name, auto policy) {
+        float s = 0;
+        ptrdiff_t c = 0;
+        const double ts = time_ms([&] { s = sum(policy, v, 0.0f); });
+        const double tc = time_ms([&] { c = count(policy, v, LessThan{0.5f}); });
+        cout << "  " << name << ": sum " << ts << " (error " << abs(s - exact) / exact << ")  count " << tc << " (" << c << ")\n";
+    };
+
+    float naive = 0;
+    const double tn = time_ms([&] { for (float x : v) naive += x; });
+    cout << "  naive loop: sum " << tn << " (error " << abs(naive - exact) / exact << ")\n";
+    report("seq (Kahan)      ", policy::seq);
+    report("unseq (pairwise) ", policy::unseq);
+    const unsigned hw = max(1u, thread::hardware_concurrency());
+    for (unsigned t = 1; t <= hw; t *= 2) {
+        cout << "  par, " << t << " thread(s)";
+        report("", policy::Parallel{t});
+    }
+}
+
+// Counting elements that satisfy three conditions: one pass per condition
+// (filtering in between, as separate filters would), a short-circuiting lambda,
+// and a fused and_/or_ predicate
+void bench_fused(size_t n)
 {
+    vector<int> v(n);
+    mt19937 gen{7};
+    uniform_int_distribution<int> dist{0, 999};
+    for (auto& x : v) x = dist(gen);
+
+    const auto p1 = outside(400, 600);
+    const auto p2 = at_least(100);
+    const auto p3 = or_(LessThan{300}, at_least(700));
+    const auto fused = and_(p1, p2, p3);
+
+    ptrdiff_t passes = 0, lambda = 0, one = 0, one_unseq = 0;
+    const double t_passes = time_ms([&] { passes = count(policy::seq, filter(filter(v, p1), p2), p3); });
+    const double t_lambda = time_ms([&] {
+        lambda = count(policy::seq, v, [&](int x) { return p1(x) && p2(x) && p3(x); });
+    });
+    const double t_fused = time_ms([&] { one = count(policy::seq, v, fused); });
+    const double t_unseq = time_ms([&] { one_unseq = count(policy::unseq, v, fused); });
+
+    cout << "3-condition count over " << n << " ints (ms):\n"
+         << "  one pass per condition " << t_passes << "  short-circuit lambda " << t_lambda
+         << "  fused " << t_fused << "  fused, unseq " << t_unseq
+         << ((passes == lambda && lambda == one && one == one_unseq) ? "  (same counts)" : "  (COUNTS DIFFER)") << "\n";
+}
+
+void* volatile escaped;  // buffers are published here so the compiler cannot drop their allocation
+
+// malloc + one finally per buffer: each guard frees its own buffer at the end of the request
+size_t handle_with_finally(const size_t* sizes, int k, size_t touched)
+{
+    if (k == 0) return touched;
+    void* p = malloc(*sizes);
+    auto release = finally([p]() noexcept { free(p); });
+    static_cast<char*>(p)[0] = 1;
+    escaped = p;
+    return handle_with_finally(sizes + 1, k - 1, touched + *sizes);
+}
+
+// Requests that each take 200 temporary buffers of 16 B to 4 KiB, released at the end of the request
+void bench_request_cleanup(int requests)
+{
+    constexpr int per_request = 200;
+    vector<size_t> sizes(per_request);
+    mt19937 gen{3};
+    uniform_int_distribution<size_t> dist{16, 4096};
+    for (auto& s : sizes) s = dist(gen);
+
+    size_t touched = 0;
+    const double t_finally = time_ms([&] {
+        for (int r = 0; r != requests; ++r) touched += handle_with_finally(sizes.data(), per_request, 0);
+    });
+
+    Request_arena arena;
+    auto arena_request = [&](bool with_cleanups, size_t& released) {
+        auto end_request = request_scope(arena);
+        for (size_t s : sizes) {
+            char* p = arena.allocate_array<char>(s);
+            p[0] = 1;
+            escaped = p;
+            touched += s;
+            if (with_cleanups) arena.defer([&released, s]() noexcept { released += s; });
+        }
+    };
+    size_t released = 0;
+    const double t_arena = time_ms([&] { for (int r = 0; r != requests; ++r) arena_request(false, released); });
+    const double t_deferred = time_ms([&] { for (int r = 0; r != requests; ++r) arena_request(true, released); });
+
+    cout << requests << " requests x " << per_request << " buffers (ns per buffer):  malloc + finally "
+         << t_finally * 1e6 / requests / per_request << "  arena " << t_arena * 1e6 / requests / per_request
+         << "  arena + defer " << t_deferred * 1e6 / requests / per_request
+         << (released * 3 == touched ? "  (all cleanups ran)" : "  (CLEANUPS MISSING)") << "\n";
+}
+
+// Usage: ch07_parameterized_operations [--bench [benchmark_size]]
+// (the benchmarks run only with --bench; default 100000000)
+int main(int argc, char* argv[])
+{
+    const bool bench = argc > 1 && string_view{argv[1]} == "--bench";
+
     // function templates
     vector v1 = { 1, 2, 3 };
     cout << "sum(v1, 0)=" << sum(v1, 0) << "\n";
+    cout << "sum(par, v1, 0)=" << sum(policy::par, v1, 0) << "\n";
 
     // function objects
     LessThan lti {42};
@@ -64,10 +592,35 @@ int main()
     // lambda
     cout << count(vector{ 1, 2, 3, 4, 5 }, [&](const int& v){ return v < 5; }) << "\n";
 
+    // composed predicates, with count, filter and transform
+    vector v2 = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    auto odd = [](int x) { return x % 2 != 0; };
+    cout << count(v2, and_(in_range(3, 8), odd)) << "\n";
+    for (int x : filter(v2, or_(LessThan{3}, not_(LessThan{8})))) cout << x << ' ';
+    cout << "\n";
+    for (int x : transform_if(v2, outside(3, 8), [](int x) { return x * x; })) cout << x << ' ';
+    cout << "\n";
+
     // finally trick
     int sz = 10;
     void *p = malloc(sizeof(int) * sz);
     auto act = finally([&]() { free(p); cout << "free called\n"; });
 
+    // request-scoped arena: one reset releases every buffer and runs every deferred cleanup
+    Request_arena arena;
+    {
+        auto end_request = request_scope(arena);
+        int* ids = arena.allocate_array<int>(100);
+        for (int i = 0; i != 100; ++i) ids[i] = i;
+        arena.defer([]() noexcept { cout << "request cleanup 1\n"; });
+        arena.defer([ids]() noexcept { cout << "request cleanup 2, ids[99]=" << ids[99] << "\n"; });
+    }
+
     cout << "ok" << endl;
+    if (!bench) return 0;
+
+    const size_t n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100'000'000;
+    bench_sum_count(n);
+    bench_fused(n);
+    bench_request_cleanup(static_cast<int>(max<size_t>(1, n / 1000)));
 }
@@ -2,68 +2,370 @@
 #include <iostream>
 #include <string>
 #include <list>
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <type_traits>
+
+#include "lifecycle_trace.h"
+#include "range_checking.h"
+#include "vector_file.h"
+
+// ===== allocators =====
+
+// Monotonic arena: hands out memory by bumping a pointer through chained blocks.
+// Individual deallocation is a no-op; everything is released at once by reset().
+class Arena {
+	struct Block {
+		Block* next;
+		std::size_t size;
+	};
+
+	Block* head = nullptr;
+	std::byte* cur = nullptr;
+	std::byte* last = nullptr;
+	std::size_t block_size;
+
+public:
+	explicit Arena(std::size_t bs = 64 * 1024) : block_size(bs) {}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena() { release(); }
+
+	void* allocate(std::size_t n, std::size_t align)
+	{
+		std::size_t pad = (align - reinterpret_cast<std::uintptr_t>(cur) % align) % align;
+		if (!cur || pad + n > static_cast<std::size_t>(last - cur)) {
+			add_block(n + align);
+			pad = (align - reinterpret_cast<std::uintptr_t>(cur) % align) % align;
+		}
+		void* p = cur + pad;
+		cur += pad + n;
+		return p;
+	}
+
+	// Keep the most recent block and rewind into it; free the rest
+	void reset()
+	{
+		if (!head) return;
+		Block* keep = head;
+		head = head->next;
+		release();
+		keep->next = nullptr;
+		head = keep;
+		cur = reinterpret_cast<std::byte*>(head + 1);
+		last = cur + head->size;
+	}
+
+private:
+	void add_block(std::size_t min)
+	{
+		std::size_t size = min > block_size ? min : block_size;
+		auto b = static_cast<Block*>(::operator new(sizeof(Block) + size));
+		b->next = head;
+		b->size = size;
+		head = b;
+		cur = reinterpret_cast<std::byte*>(b + 1);
+		last = cur + size;
+	}
+
+	void release()
+	{
+		while (head) {
+			Block* next = head->next;
+			::operator delete(head);
+			head = next;
+		}
+		cur = last = nullptr;
+	}
+};
+
+// Fixed-size pool: a free list of equal-sized blocks carved out of larger chunks.
+// Requests bigger than the block size go straight to operator new.
+class Pool {
+	struct Node { Node* next; };
+	struct Chunk { Chunk* next; };
+
+	Node* free = nullptr;
+	Chunk* chunks = nullptr;
+	std::size_t block_size;
+	std::size_t blocks_per_chunk;
+
+public:
+	explicit Pool(std::size_t bs, std::size_t n = 1024)
+		: block_size((bs + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+		  blocks_per_chunk(n) {}
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+	~Pool()
+	{
+		while (chunks) {
+			Chunk* next = chunks->next;
+			::operator delete(chunks);
+			chunks = next;
+		}
+	}
+
+	void* allocate(std::size_t n)
+	{
+		if (n > block_size) return ::operator new(n);
+		if (!free) refill();
+		Node* p = free;
+		free = free->next;
+		return p;
+	}
+
+	void deallocate(void* p, std::size_t n)
+	{
+		if (n > block_size) { ::operator delete(p); return; }
+		auto node = static_cast<Node*>(p);
+		node->next = free;
+		free = node;
+	}
+
+private:
+	void refill()
+	{
+		constexpr std::size_t header = alignof(std::max_align_t);  // keeps blocks max-aligned
+		auto c = static_cast<Chunk*>(::operator new(header + block_size * blocks_per_chunk));
+		c->next = chunks;
+		chunks = c;
+		auto base = reinterpret_cast<std::byte*>(c) + header;
+		for (std::size_t i = blocks_per_chunk; i-- != 0;) {
+			auto node = reinterpret_cast<Node*>(base + i * block_size);
+			node->next = free;
+			free = node;
+		}
+	}
+};
+
+// std::allocator-compatible handles to an Arena and a Pool
 
 template<typename T>
-class Vector {
+struct ArenaAllocator {
+	using value_type = T;
+	Arena* arena;
+
+	ArenaAllocator(Arena& a) : arena(&a) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, std::size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+};
+
+template<typename T>
+struct PoolAllocator {
+	using value_type = T;
+	Pool* pool;
+
+	PoolAllocator(Pool& p) : pool(&p) {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+	void deallocate(T* p, std::size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+};
+
+template<typename A, typename U>
+using Rebind = typename std::allocator_traits<A>::template rebind_alloc<U>;
+
+// ===== Vector with an allocator parameter =====
+
+// Elements are constructed exactly once, directly in uninitialized storage
+// obtained from A (no default construction followed by assignment).
+// Element types that take an allocator (e.g. std::list<int, A>) are given
+// a rebound copy of ours, so their own nodes come from the same source.
+// Constructions and allocations are counted by Traced (lifecycle_trace.h).
+template<typename T, typename A = std::allocator<T>, Checking C = vector_checking>
+class Vector : private Traced<Vector<T, A, C>> {
 private:
+	[[no_unique_address]] A alloc;
 	T* elem;
 	int sz;
 public:
-	explicit Vector(int s);
-	~Vector() { delete[] elem; }
-	
+	explicit Vector(int s, const A& a = A{});
+	~Vector();
+	Vector(const Vector&) = delete;
+	Vector& operator=(const Vector&) = delete;
+
 	T& operator[](int i);
 	const T& operator[](int i) const;
+	T& at(int i);
+	const T& at(int i) const;
 	int size() const { return sz; }
+
+	// contiguous iterators
+	T* data() { return elem; }
+	const T* data() const { return elem; }
+	T* begin() { return elem; }
+	T* end() { return elem + sz; }
+	const T* begin() const { return elem; }
+	const T* end() const { return elem + sz; }
 };
 
 // ===== simple templated member function =====
 
-template<typename T>
-Vector<T>::Vector(int s)
+template<typename T, typename A, Checking C>
+Vector<T, A, C>::Vector(int s, const A& a) : alloc(a)
 {
 	if (s < 0) throw std::length_error{"Vector constructor: negative size"};
-	elem = new T[s];
+	elem = std::allocator_traits<A>::allocate(alloc, s);
+	this->traced_allocation();
+	int i = 0;
+	try {
+		for (; i != s; ++i)
+			std::uninitialized_construct_using_allocator(elem + i, alloc);
+	}
+	catch (...) {
+		std::destroy_n(elem, i);
+		std::allocator_traits<A>::deallocate(alloc, elem, s);
+		this->traced_deallocation();
+		throw;
+	}
 	sz = s;
 }
 
-template<typename T>
-const T& Vector<T>::operator[](int i) const
+template<typename T, typename A, Checking C>
+Vector<T, A, C>::~Vector()
 {
-	if (i < 0 || i >= size()) throw std::out_of_range{"Vector::operator[]"};
+	for (int i = 0; i != sz; ++i)
+		std::allocator_traits<A>::destroy(alloc, elem + i);
+	std::allocator_traits<A>::deallocate(alloc, elem, sz);
+	this->traced_deallocation();
+}
+
+template<typename T, typename A, Checking C>
+const T& Vector<T, A, C>::operator[](int i) const
+{
+	if constexpr (check_subscripts<C>)
+		if (i < 0 || i >= size()) throw std::out_of_range{"Vector::operator[]"};
 	return elem[i];
 }
 
-template<typename T>
-T& Vector<T>::operator[](int i)
+template<typename T, typename A, Checking C>
+T& Vector<T, A, C>::operator[](int i)
 {
-	if (i < 0 || i >= size()) throw std::out_of_range{"Vector::operator[]"};
+	if constexpr (check_subscripts<C>)
+		if (i < 0 || i >= size()) throw std::out_of_range{"Vector::operator[]"};
+	return elem[i];
+}
+
+template<typename T, typename A, Checking C>
+const T& Vector<T, A, C>::at(int i) const
+{
+	if (i < 0 || i >= size()) throw std::out_of_range{"Vector::at"};
+	return elem[i];
+}
+
+template<typename T, typename A, Checking C>
+T& Vector<T, A, C>::at(int i)
+{
+	if (i < 0 || i >= size()) throw std::out_of_range{"Vector::at"};
 	return elem[i];
 }
 
 // ===== simple begin() and end() =====
 
-template<typename T>
-T* begin(Vector<T>& x)
+template<typename T, typename A, Checking C>
+T* begin(Vector<T, A, C>& x)
 {
-	return &x[0];
+	return x.data();	// not &x[0], which is out of range for an empty Vector
 }
 
-template<typename T>
-T* end(Vector<T>& x)
+template<typename T, typename A, Checking C>
+T* end(Vector<T, A, C>& x)
 {
-	return &x[0] + x.size();
+	return x.data() + x.size();
 }
 
-template<typename T>
-void dump(Vector<T>& x)
+template<typename T, typename A, Checking C>
+void dump(Vector<T, A, C>& x)
 {
 	for (auto& e : x) std::cout << e << ", ";
 	std::cout << "\n";
 }
 
+// ===== binary files =====
+
+// Vector files (see vector_file.h) hold any arithmetic element type;
+// Mapped_vector<T> and Vector_appender<T> read and extend them
+
+template<typename T, typename A, Checking C>
+void save(const Vector<T, A, C>& v, const std::string& path)
+{
+	save(std::span<const T>{v.data(), static_cast<std::size_t>(v.size())}, path);
+}
+
+// ===== benchmark =====
+
+// Construct and destroy the v1/v2/v3 cases of main() iters times with allocator a,
+// putting a few elements in each list of v3; reset() is called after each round.
+template<typename Alloc, typename Reset>
+double bench_v123(const char* name, Alloc a, Reset reset, int iters)
+{
+	using String = std::basic_string<char, std::char_traits<char>, Rebind<Alloc, char>>;
+	using List = std::list<int, Rebind<Alloc, int>>;
+
+	long long check = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (int n = 0; n != iters; ++n) {
+		{
+			Vector<int, Rebind<Alloc, int>> v1(100, a);
+			Vector<String, Rebind<Alloc, String>> v2(0, a);
+			Vector<List, Rebind<Alloc, List>> v3(20, a);
+			for (auto& l : v3)
+				for (int i = 0; i != 4; ++i) l.push_back(i);
+			check += v1[99] + v2.size() + v3[19].size();
+		}
+		reset();
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+	std::cout << name << ": " << ns << " ns per round (check " << check << ")\n";
+	return ns;
+}
+
 int main() {
 	Vector<int> v1(100);
 	Vector<std::string> v2(0);
 	Vector<std::list<int>> v3(20);
+
+	// save v1, extend the file, and use it in place
+	const auto path = (std::filesystem::temp_directory_path() / "ch07_templates_v1.bin").string();
+	for (int i = 0; i != v1.size(); ++i) v1[i] = i;
+	save(v1, path);
+	{
+		Vector_appender<int> app{path};
+		for (int i = 0; i != 5; ++i) app.push_back(1000 + i);
+	}
+	{
+		Mapped_vector<int> m{path};
+		std::cout << "mapped " << m.size() << " ints, last = " << m[m.size() - 1]
+				  << ", checksum " << (m.verify() ? "ok" : "BAD") << "\n";
+	}
+	std::filesystem::remove(path);
+
+	const int iters = 100'000;
+	std::cout << "construct + destroy v1/v2/v3:\n";
+	bench_v123("  std::allocator", std::allocator<char>{}, [] {}, iters);
+
+	Arena arena;
+	bench_v123("  Arena         ", ArenaAllocator<char>{arena}, [&] { arena.reset(); }, iters);
+
+	Pool pool(64);
+	bench_v123("  Pool          ", PoolAllocator<char>{pool}, [] {}, iters);
+
+	lifecycle_report(std::cout);
 }
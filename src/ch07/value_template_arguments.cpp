@@ -1,24 +1,456 @@
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Buffer<T, N>: a vector whose capacity N is part of its type ("static_vector").
+// The elements live inside the Buffer itself, so push_back/insert/erase never
+// allocate; growing past N throws std::length_error (or fails, for try_push_back).
+// The storage is a union, so slots past size() hold no constructed T: T need not
+// be default constructible, and non-trivial T (std::string, std::unique_ptr, ...)
+// is constructed and destroyed exactly as elements come and go.
+// Everything is constexpr.
 template<typename T, int N>
-struct Buffer
+class Buffer
 {
-    constexpr int size() { return N; }
-    T elemp[N];
+    static_assert(N > 0);
+
+    union Storage
+    {
+        constexpr Storage() {}
+        constexpr ~Storage() requires std::is_trivially_destructible_v<T> = default;
+        constexpr ~Storage() {}
+        T elem[N];
+    };
+
+    Storage st;
+    std::size_t sz = 0;     // not int: stores into a Buffer<int> could then alias it, and push_back loops would reload it
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    constexpr Buffer() noexcept {}
+
+    // The constructors destroy what they have built if an element's constructor
+    // throws (~Buffer does not run for a Buffer that was never constructed)
+    constexpr Buffer(std::initializer_list<T> lst)
+    {
+        if (lst.size() > N) throw std::length_error{"Buffer: initializer list too long"};
+        try {
+            for (const T& x : lst) emplace_back(x);
+        }
+        catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    constexpr Buffer(const Buffer& other)
+    {
+        try {
+            for (const T& x : other) emplace_back(x);
+        }
+        catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    constexpr Buffer(Buffer&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        try {
+            for (T& x : other) emplace_back(std::move(x));
+        }
+        catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    constexpr Buffer& operator=(const Buffer& other)
+    {
+        if (this != &other) {
+            clear();
+            for (const T& x : other) emplace_back(x);   // if a copy throws, the elements copied so far remain
+        }
+        return *this;
+    }
+
+    constexpr Buffer& operator=(Buffer&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this != &other) {
+            clear();
+            for (T& x : other) emplace_back(std::move(x));
+        }
+        return *this;
+    }
+
+    constexpr ~Buffer() requires std::is_trivially_destructible_v<T> = default;
+    constexpr ~Buffer() { clear(); }
+
+    static constexpr int capacity() { return N; }
+    constexpr int size() const { return static_cast<int>(sz); }
+    constexpr bool empty() const { return sz == 0; }
+    constexpr bool full() const { return sz == N; }
+
+    constexpr T* data() { return st.elem; }
+    constexpr const T* data() const { return st.elem; }
+    constexpr iterator begin() { return st.elem; }
+    constexpr iterator end() { return st.elem + sz; }
+    constexpr const_iterator begin() const { return st.elem; }
+    constexpr const_iterator end() const { return st.elem + sz; }
+
+    constexpr T& operator[](int i) { return st.elem[i]; }              // unchecked
+    constexpr const T& operator[](int i) const { return st.elem[i]; }
+
+    constexpr T& at(int i)
+    {
+        if (i < 0 || static_cast<std::size_t>(i) >= sz) throw std::out_of_range{"Buffer::at"};
+        return st.elem[i];
+    }
+
+    constexpr const T& at(int i) const
+    {
+        if (i < 0 || static_cast<std::size_t>(i) >= sz) throw std::out_of_range{"Buffer::at"};
+        return st.elem[i];
+    }
+
+    constexpr T& front() { return st.elem[0]; }
+    constexpr T& back() { return st.elem[sz - 1]; }
+
+    template<typename... Args>
+    constexpr T& emplace_back(Args&&... args)
+    {
+        if (sz == N) throw std::length_error{"Buffer: full"};
+        T* p = std::construct_at(st.elem + sz, std::forward<Args>(args)...);
+        ++sz;
+        return *p;
+    }
+
+    constexpr void push_back(const T& x) { emplace_back(x); }
+    constexpr void push_back(T&& x) { emplace_back(std::move(x)); }
+
+    // For hot paths that handle overflow themselves: false (and no change) when full
+    constexpr bool try_push_back(const T& x)
+    {
+        if (sz == N) return false;
+        std::construct_at(st.elem + sz, x);
+        ++sz;
+        return true;
+    }
+
+    constexpr void pop_back() { std::destroy_at(st.elem + --sz); }
+
+    constexpr iterator insert(const_iterator pos, T x)
+    {
+        if (sz == N) throw std::length_error{"Buffer: full"};
+        T* p = begin() + (pos - begin());
+        if (p == end()) {
+            std::construct_at(p, std::move(x));
+            ++sz;
+        }
+        else {
+            std::construct_at(end(), std::move(back()));   // open up a slot at the end
+            ++sz;                                          // before the moves, which may throw
+            std::move_backward(p, end() - 2, end() - 1);
+            *p = std::move(x);
+        }
+        return p;
+    }
+
+    constexpr iterator erase(const_iterator first, const_iterator last)
+    {
+        T* p = begin() + (first - begin());
+        T* q = begin() + (last - begin());
+        T* new_end = std::move(q, end(), p);
+        std::destroy(new_end, end());
+        sz = static_cast<std::size_t>(new_end - begin());
+        return p;
+    }
+
+    constexpr iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    constexpr void clear()
+    {
+        std::destroy(begin(), end());
+        sz = 0;
+    }
+
+    friend constexpr bool operator==(const Buffer& a, const Buffer& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
 };
 
 Buffer<char, 256> buf;
 
+// Buffer works at compile time, insert and erase included
+constexpr int buffer_check()
+{
+    Buffer<int, 8> b{ 1, 2, 4 };
+    b.insert(b.begin() + 2, 3);          // 1 2 3 4
+    b.push_back(5);                      // 1 2 3 4 5
+    b.erase(b.begin());                  // 2 3 4 5
+    b.erase(b.begin() + 1, b.begin() + 3); // 2 5
+    int sum = 0;
+    for (int x : b) sum += x;
+    return sum * 10 + b.size();
+}
+
+static_assert(buffer_check() == 72);
+static_assert(std::is_trivially_destructible_v<Buffer<char, 256>>);
+
+// Lock-free ring queues with Buffer<T, N> as their storage (N a power of two,
+// so a position maps to its slot with a mask). The indices written by producers
+// and by consumers sit on separate cache lines, so the two sides do not
+// invalidate each other's lines on every operation.
+// Full and empty are reported, not waited on: push returns false when full,
+// pop returns false when empty.
+// Unlike Buffer itself, the rings need T to be default constructible: every
+// slot holds a T from the start, and elements are copied into and moved out
+// of slots by assignment.
+constexpr std::size_t cache_line = 64;
+
+// One producer thread, one consumer thread. Each side keeps a cached copy
+// of the other's index and rereads the shared one only when the cache says
+// the ring is full (or empty).
+template<typename T, int N>
+class Spsc_ring
+{
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    static_assert(std::is_default_constructible_v<T> && std::is_copy_assignable_v<T>, "ring elements are assigned into constructed slots");
+    static constexpr std::size_t mask = N - 1;
+
+    alignas(cache_line) std::atomic<std::size_t> head{0};  // next position to read; written by the consumer
+    std::size_t tail_seen = 0;                              // consumer's copy of tail
+    alignas(cache_line) std::atomic<std::size_t> tail{0};  // next position to write; written by the producer
+    std::size_t head_seen = 0;                              // producer's copy of head
+    alignas(cache_line) Buffer<T, N> slots;
+
+public:
+    Spsc_ring()
+    {
+        while (!slots.full()) slots.emplace_back();
+    }
+
+    bool push(const T& x) { return push(&x, 1) == 1; }
+    bool pop(T& x) { return pop(&x, 1) == 1; }
+
+    // push up to n elements; returns how many fit
+    int push(const T* first, int n)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_seen + n > N) head_seen = head.load(std::memory_order_acquire);
+        const int k = std::min<int>(n, static_cast<int>(N - (t - head_seen)));
+        for (int i = 0; i != k; ++i) slots[(t + i) & mask] = first[i];
+        tail.store(t + k, std::memory_order_release);
+        return k;
+    }
+
+    // pop up to n elements into out; returns how many there were
+    int pop(T* out, int n)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (tail_seen - h < static_cast<std::size_t>(n)) tail_seen = tail.load(std::memory_order_acquire);
+        const int k = std::min<int>(n, static_cast<int>(tail_seen - h));
+        for (int i = 0; i != k; ++i) out[i] = std::move(slots[(h + i) & mask]);
+        head.store(h + k, std::memory_order_release);
+        return k;
+    }
+};
+
+// Any number of producers and consumers (Vyukov's bounded queue). Each slot
+// carries a sequence number that says whose turn it is: equal to a position p
+// when a producer may write p, p + 1 when a consumer may read it. Producers
+// claim positions with a CAS on tail, consumers with a CAS on head.
+template<typename T, int N>
+class Mpmc_ring
+{
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    static_assert(std::is_default_constructible_v<T> && std::is_copy_assignable_v<T>, "ring elements are assigned into constructed slots");
+    static constexpr std::size_t mask = N - 1;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> seq;
+        T value{};
+        explicit Slot(std::size_t s) : seq{s} {}
+    };
+
+    alignas(cache_line) std::atomic<std::size_t> head{0};
+    alignas(cache_line) std::atomic<std::size_t> tail{0};
+    alignas(cache_line) Buffer<Slot, N> slots;
+
+    // Claim up to n consecutive positions from pos, whose slots have sequence
+    // number position + ready; returns the first position and how many were claimed
+    std::pair<std::size_t, int> claim(std::atomic<std::size_t>& pos, int n, std::size_t ready)
+    {
+        std::size_t p = pos.load(std::memory_order_relaxed);
+        for (;;) {
+            int k = 0;
+            while (k != n && slots[(p + k) & mask].seq.load(std::memory_order_acquire) == p + k + ready) ++k;
+            if (k == 0) {
+                const std::size_t seq = slots[p & mask].seq.load(std::memory_order_acquire);
+                if (static_cast<std::intptr_t>(seq - (p + ready)) < 0) return {p, 0};  // full (or empty)
+                p = pos.load(std::memory_order_relaxed);                               // someone else got there first
+            }
+            else if (pos.compare_exchange_weak(p, p + k, std::memory_order_relaxed)) {
+                return {p, k};
+            }
+        }
+    }
+
+public:
+    Mpmc_ring()
+    {
+        for (std::size_t i = 0; i != N; ++i) slots.emplace_back(i);
+    }
+
+    bool push(const T& x) { return push(&x, 1) == 1; }
+    bool pop(T& x) { return pop(&x, 1) == 1; }
+
+    int push(const T* first, int n)
+    {
+        const auto [p, k] = claim(tail, n, 0);
+        for (int i = 0; i != k; ++i) {
+            Slot& s = slots[(p + i) & mask];
+            s.value = first[i];
+            s.seq.store(p + i + 1, std::memory_order_release);
+        }
+        return k;
+    }
+
+    int pop(T* out, int n)
+    {
+        const auto [p, k] = claim(head, n, 1);
+        for (int i = 0; i != k; ++i) {
+            Slot& s = slots[(p + i) & mask];
+            out[i] = std::move(s.value);
+            s.seq.store(p + i + N, std::memory_order_release);  // free for the producer one lap later
+        }
+        return k;
+    }
+};
+
 template<char* s>
 void outs() { std::cout << s << "\n"; }
 
 char arr[] = "Hello";
 std::string s = "Hello";
 
-int main()
+volatile int sink; // keeps the benchmark loops from being optimized away
+
+// Fill a container with n ints, read them back and destroy it, many times over:
+// std::vector with reserve() against Buffer<int, N>; nanoseconds per element
+template<int N>
+void bench_buffer(long total)
+{
+    const long reps = std::max(1L, total / N);
+    auto time_ns = [&](auto f) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (long r = 0; r != reps; ++r) f(r);
+        auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double(reps) * N);
+    };
+
+    const double vec = time_ns([](long r) {
+        std::vector<int> v;
+        v.reserve(N);
+        for (int i = 0; i != N; ++i) v.push_back(i ^ static_cast<int>(r));
+        int sum = 0;
+        for (int x : v) sum += x;
+        sink = sum;
+    });
+    const double inl = time_ns([](long r) {
+        Buffer<int, N> b;
+        for (int i = 0; i != N; ++i) b.push_back(i ^ static_cast<int>(r));
+        int sum = 0;
+        for (int x : b) sum += x;
+        sink = sum;
+    });
+    std::cout << "  N = " << N << ": std::vector + reserve " << vec << "  Buffer " << inl << "\n";
+}
+
+// Pass messages through a ring from producers to consumers (batch messages per
+// push/pop); each message carries its send time. Reports messages per second
+// and the 99th percentile of send-to-receive latency.
+template<typename Ring>
+void bench_ring(const char* name, int producers, int consumers, long messages, int batch)
+{
+    using clock = std::chrono::steady_clock;
+    auto ring = std::make_unique<Ring>();  // big, and over-aligned: not for the stack
+    const long per_producer = messages / producers;
+    const long total = per_producer * producers;
+    std::atomic<long> received{0};
+    std::vector<std::vector<std::int64_t>> latency(consumers);
+
+    auto t0 = clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p != producers; ++p)
+        threads.emplace_back([&] {
+            std::vector<std::int64_t> msg(batch);
+            for (long sent = 0; sent < per_producer;) {
+                const int k = static_cast<int>(std::min<long>(batch, per_producer - sent));
+                const std::int64_t now = clock::now().time_since_epoch().count();
+                for (int i = 0; i != k; ++i) msg[i] = now;
+                for (int done = 0; done != k;) {
+                    const int n = ring->push(msg.data() + done, k - done);
+                    if (n == 0) std::this_thread::yield();
+                    done += n;
+                }
+                sent += k;
+            }
+        });
+    for (int c = 0; c != consumers; ++c)
+        threads.emplace_back([&, c] {
+            std::vector<std::int64_t> msg(batch);
+            auto& lat = latency[c];
+            while (received.load(std::memory_order_relaxed) < total) {
+                const int n = ring->pop(msg.data(), batch);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                const std::int64_t now = clock::now().time_since_epoch().count();
+                for (int i = 0; i != n; ++i) lat.push_back(now - msg[i]);
+                received.fetch_add(n, std::memory_order_relaxed);
+            }
+        });
+    for (auto& t : threads) t.join();
+    const double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+    std::vector<std::int64_t> all;
+    for (const auto& l : latency) all.insert(all.end(), l.begin(), l.end());
+    const auto p99 = all.begin() + static_cast<long>(all.size() * 99 / 100);
+    std::nth_element(all.begin(), p99, all.end());
+    std::cout << "  " << name << " " << producers << "P/" << consumers << "C batch " << batch << ": "
+              << total / seconds / 1e6 << " M msgs/s, p99 latency "
+              << std::chrono::duration<double, std::micro>(clock::duration{*p99}).count() << " us"
+              << (static_cast<long>(all.size()) == total ? "" : "  (MESSAGES LOST)") << "\n";
+}
+
+// Usage: ch07_value_template_arguments [--bench [benchmark_elements]]
+// (the benchmarks run only with --bench; default 100000000 elements per N)
+int main(int argc, char* argv[])
 {
+    const bool bench = argc > 1 && std::string_view{argv[1]} == "--bench";
+
     Buffer<float, 1024> locbuf;
+    locbuf.push_back(1.5f);
 
     constexpr char locarr[] = "World";
     std::string locs = "World";
@@ -28,5 +460,35 @@ int main()
     // outs<locarr>();
     // outs<s.c_str()>();
 
+    // non-trivial elements are constructed only when added
+    Buffer<std::string, 4> words{ "inline", "storage" };
+    words.insert(words.begin(), "no");
+    words.emplace_back(3, '!');
+    for (const auto& w : words) std::cout << w << ' ';
+    std::cout << "(" << words.size() << "/" << words.capacity() << ")\n";
+    try {
+        words.push_back("overflow");
+    }
+    catch (const std::length_error& e) {
+        std::cout << "length_error: " << e.what() << "\n";
+    }
+
     std::cout << "ok\n";
+    if (!bench) return 0;
+
+    const long total = argc > 2 ? std::atol(argv[2]) : 100'000'000;
+    std::cout << "fill + read + destroy (ns per element):\n";
+    bench_buffer<8>(total);
+    bench_buffer<64>(total);
+    bench_buffer<512>(total);
+    bench_buffer<4096>(total);
+
+    const long messages = std::max(1000L, total / 50);
+    std::cout << "ring queues, " << messages << " messages of 1024 slots:\n";
+    bench_ring<Spsc_ring<std::int64_t, 1024>>("SPSC", 1, 1, messages, 1);
+    bench_ring<Spsc_ring<std::int64_t, 1024>>("SPSC", 1, 1, messages, 32);
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        bench_ring<Mpmc_ring<std::int64_t, 1024>>("MPMC", threads, threads, messages, 1);
+        bench_ring<Mpmc_ring<std::int64_t, 1024>>("MPMC", threads, threads, messages, 32);
+    }
 }